@@ -0,0 +1,321 @@
+//
+// Asynchronous I/O: requests taken from a process's
+// submission ring are run by kernel worker processes,
+// which post results to the completion ring.
+// See aio.h for the ring layout.
+//
+
+#include "types.h"
+#include "riscv.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "fs.h"
+#include "sleeplock.h"
+#include "file.h"
+#include "aio.h"
+
+struct aioreq {
+  struct proc *p;       // submitter
+  struct proc *w;       // worker running it, once started
+  struct file *f;       // referenced file, if the op has an fd
+  struct inode *cwd;    // referenced cwd, for AIO_OPEN
+  struct aio_sqe sqe;
+  struct aioreq *next;
+};
+
+// aio.lock protects the request lists and every process's
+// ainflight count and completion ring tail.
+struct {
+  struct spinlock lock;
+  struct aioreq req[NAIOREQ];
+  struct aioreq *free;
+  struct aioreq *head;  // pending, oldest first
+  struct aioreq **tail;
+} aio;
+
+static void aioworker(void);
+
+void
+aioinit(void)
+{
+  struct aioreq *q;
+
+  initlock(&aio.lock, "aio");
+  for(q = aio.req; q < &aio.req[NAIOREQ]; q++){
+    q->next = aio.free;
+    aio.free = q;
+  }
+  aio.tail = &aio.head;
+  for(int i = 0; i < NAIOWORKER; i++)
+    if(kthread(aioworker, "aioworker") < 0)
+      panic("aioinit");
+}
+
+// Post a completion for p.
+// Caller holds aio.lock.
+static void
+post(struct proc *p, uint64 udata, int res)
+{
+  struct aio_ring *r = p->aring;
+  struct aio_cqe *c = &r->cq[r->cq_tail % NCQE];
+
+  c->udata = udata;
+  c->res = res;
+  __sync_synchronize();
+  r->cq_tail++;
+  wakeup(r);
+}
+
+// Run q on behalf of its submitter. The worker borrows the
+// submitter's page table so that fileread() and filewrite()
+// copy to and from the submitter's memory, and gives up
+// waiting in them if the submitter is killed.
+static int
+aiodo(struct aioreq *q)
+{
+  struct proc *w = myproc();
+  pagetable_t own = w->pagetable;
+  char path[MAXPATH];
+  struct file *f;
+  int r = -1;
+
+  w->pagetable = q->p->pagetable;
+  w->aiofor = q->p;
+  switch(q->sqe.op){
+  case AIO_READ:
+    r = fileread(q->f, q->sqe.addr, q->sqe.n);
+    break;
+  case AIO_WRITE:
+    r = filewrite(q->f, q->sqe.addr, q->sqe.n);
+    break;
+  case AIO_OPEN:
+    w->cwd = q->cwd;
+    if(copyinstr(w->pagetable, path, q->sqe.addr, MAXPATH) == 0 &&
+       (f = fileopen(path, q->sqe.n)) != 0){
+      if((r = fdinstall(q->p, f)) < 0)
+        fileclose(f);
+    }
+    w->cwd = 0;
+    begin_op();
+    iput(q->cwd);
+    end_op();
+    break;
+  case AIO_CLOSE:
+    r = 0;
+    break;
+  case AIO_FSYNC:
+    if(q->f->type == FD_INODE){
+      log_force();
+      r = 0;
+    }
+    break;
+  }
+  w->pagetable = own;
+  w->aiofor = 0;
+
+  if(q->f)
+    fileclose(q->f);
+  return r;
+}
+
+static void
+aioworker(void)
+{
+  struct aioreq *q;
+  int r;
+
+  for(;;){
+    acquire(&aio.lock);
+    while(aio.head == 0)
+      sleep(&aio.head, &aio.lock);
+    q = aio.head;
+    if((aio.head = q->next) == 0)
+      aio.tail = &aio.head;
+    q->w = myproc();
+    release(&aio.lock);
+
+    r = aiodo(q);
+
+    acquire(&aio.lock);
+    post(q->p, q->sqe.udata, r);
+    if(--q->p->ainflight == 0)
+      wakeup(&q->p->ainflight);
+    q->w = 0;
+    q->next = aio.free;
+    aio.free = q;
+    wakeup(&aio.free);
+    release(&aio.lock);
+  }
+}
+
+// Check an entry and take references on whatever it names.
+// Returns 0 if the entry can be queued.
+// Caller holds aio.lock.
+static int
+prepare(struct proc *p, struct aioreq *q)
+{
+  int fd = q->sqe.fd;
+
+  q->p = p;
+  q->w = 0;
+  q->f = 0;
+  q->cwd = 0;
+  switch(q->sqe.op){
+  case AIO_OPEN:
+    q->cwd = cwdup(p);
+    return 0;
+  case AIO_READ:
+  case AIO_WRITE:
+  case AIO_CLOSE:
+  case AIO_FSYNC:
+    if(fd < 0 || fd >= NOFILE)
+      return -1;
+    acquire(&p->leader->sharelock);
+    if(p->ofile[fd] == 0){
+      release(&p->leader->sharelock);
+      return -1;
+    }
+    if(q->sqe.op == AIO_CLOSE){
+      // the descriptor goes away now; the worker
+      // drops the last reference.
+      q->f = p->ofile[fd];
+      p->ofile[fd] = 0;
+    } else {
+      q->f = filedup(p->ofile[fd]);
+    }
+    release(&p->leader->sharelock);
+    return 0;
+  }
+  return -1;
+}
+
+// Map a ring for the calling process.
+// Returns its user address, or -1.
+uint64
+sys_aiosetup(void)
+{
+  struct proc *p = myproc();
+  char *mem;
+
+  if(p->aring)
+    return AIORING;
+  if(p->leader != p || p->nthread > 0)  // only single-threaded processes
+    return -1;
+  if((mem = kalloc()) == 0)
+    return -1;
+  zero_page(mem);
+  if(mappages(p->pagetable, AIORING, PGSIZE, (uint64)mem,
+              PTE_R | PTE_W | PTE_U) != 0){
+    kfree(mem);
+    return -1;
+  }
+  p->aring = (struct aio_ring *)mem;
+  return AIORING;
+}
+
+// aioenter(nsubmit, minwait): queue up to nsubmit new
+// submission entries, then wait until at least minwait
+// completions are ready to consume.
+// Returns the number of entries taken from the ring.
+uint64
+sys_aioenter(void)
+{
+  struct proc *p = myproc();
+  struct aio_ring *r = p->aring;
+  struct aioreq *q;
+  int nsubmit, minwait, n;
+
+  if(r == 0 || argint(0, &nsubmit) < 0 || argint(1, &minwait) < 0)
+    return -1;
+  if(minwait > NCQE)
+    minwait = NCQE;
+
+  acquire(&aio.lock);
+  for(n = 0; n < nsubmit && r->sq_head != r->sq_tail; n++){
+    // leave room in the completion ring for every
+    // request that might finish.
+    if(r->cq_tail - r->cq_head + p->ainflight >= NCQE)
+      break;
+    while((q = aio.free) == 0)
+      sleep(&aio.free, &aio.lock);
+    __sync_synchronize();
+    q->sqe = r->sq[r->sq_head % NSQE];
+    r->sq_head++;
+    if(prepare(p, q) < 0){
+      post(p, q->sqe.udata, -1);
+      continue;
+    }
+    aio.free = q->next;
+    q->next = 0;
+    *aio.tail = q;
+    aio.tail = &q->next;
+    p->ainflight++;
+    wakeup(&aio.head);
+  }
+
+  while(r->cq_tail - r->cq_head < minwait && p->ainflight > 0 && !p->killed)
+    sleep(r, &aio.lock);
+  release(&aio.lock);
+  return n;
+}
+
+// Wake the workers running p's requests, so that a read or
+// write waiting for a pipe or the console sees p is killed.
+// Caller holds aio.lock.
+static void
+aiokick(struct proc *p)
+{
+  struct aioreq *q;
+  struct proc *w;
+
+  for(q = aio.req; q < &aio.req[NAIOREQ]; q++){
+    if(q->p != p || (w = q->w) == 0)
+      continue;
+    acquire(&w->lock);
+    if(w->state == SLEEPING)
+      w->state = RUNNABLE;
+    release(&w->lock);
+  }
+  kickidle();
+}
+
+// Are any of p's requests not yet completed? Workers use
+// p's memory until they are.
+int
+aiobusy(struct proc *p)
+{
+  int busy;
+
+  acquire(&aio.lock);
+  busy = p->ainflight > 0;
+  release(&aio.lock);
+  return busy;
+}
+
+// Wait for p's outstanding requests, then unmap and free
+// its ring. Called by exit() and exec(), since workers use
+// p's page table and descriptor table. Requests waiting on a
+// pipe or the console could wait forever (for a writer that
+// is p itself, say), so they are told to give up; a worker
+// may miss a kick just before it sleeps, so kick every tick.
+void
+aioexit(struct proc *p)
+{
+  if(p->aring == 0)
+    return;
+  acquire(&aio.lock);
+  p->aiostop = 1;
+  while(p->ainflight > 0){
+    aiokick(p);
+    release(&aio.lock);
+    sleepuntil(r_time() + TICKCYCLES);
+    acquire(&aio.lock);
+  }
+  p->aiostop = 0;
+  release(&aio.lock);
+  uvmunmap(p->pagetable, AIORING, 1, 1);
+  p->aring = 0;
+}
@@ -0,0 +1,41 @@
+// Asynchronous I/O rings, shared by a process and the kernel.
+//
+// aiosetup() maps one struct aio_ring at AIORING. The process
+// fills sq[sq_tail % NSQE] and advances sq_tail, then calls
+// aioenter() to hand the new entries to kernel workers.
+// Workers post results at cq[cq_tail % NCQE] and advance
+// cq_tail; the process consumes them and advances cq_head.
+// The indices only ever increase.
+
+#define AIO_READ   1   // read(fd, addr, n)
+#define AIO_WRITE  2   // write(fd, addr, n)
+#define AIO_OPEN   3   // open(addr, n); result is the fd
+#define AIO_CLOSE  4   // close(fd)
+#define AIO_FSYNC  5   // wait for fd's writes to reach the log
+
+#define NSQE 64
+#define NCQE 64
+
+struct aio_sqe {
+  int op;         // AIO_*
+  int fd;
+  uint64 addr;    // buffer, or path for AIO_OPEN
+  int n;          // byte count, or mode for AIO_OPEN
+  int pad;
+  uint64 udata;   // copied to the completion
+};
+
+struct aio_cqe {
+  uint64 udata;
+  int res;        // what the synchronous call would return
+  int pad;
+};
+
+struct aio_ring {
+  uint sq_head;   // advanced by the kernel
+  uint sq_tail;   // advanced by the process
+  uint cq_head;   // advanced by the process
+  uint cq_tail;   // advanced by the kernel
+  struct aio_sqe sq[NSQE];
+  struct aio_cqe cq[NCQE];
+};
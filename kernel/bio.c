@@ -22,6 +22,8 @@
 #include "defs.h"
 #include "fs.h"
 #include "buf.h"
+#include "ktrace.h"
+#include "stats.h"
 
 struct {
   struct spinlock lock;  // bcacheڲݣbufڵsleeplockblockcache
@@ -30,6 +32,7 @@ struct {
   // Linked list of all buffers, through prev/next.
   // Sorted by how recently the buffer was used.
   // head.next is most recent, head.prev is least.
+  uint64 hits, misses;  // bget() lookups
   struct buf head;   // һͷڵ㣬ʲô
 } bcache;
 
@@ -67,6 +70,7 @@ bget(uint dev, uint blockno)
   for(b = bcache.head.next; b != &bcache.head; b = b->next){
     if(b->dev == dev && b->blockno == blockno){
       b->refcnt++;
+      bcache.hits++;
       release(&bcache.lock);
       acquiresleep(&b->lock);  // 뻺øУ˯ߣѵǰ̼뵽ĵȴСreleasesleepлwakeupѵȴеһ
       return b;
@@ -76,11 +80,14 @@ bget(uint dev, uint blockno)
   // Not cached.
   // Recycle the least recently used (LRU) unused buffer.
   for(b = bcache.head.prev; b != &bcache.head; b = b->prev){  // LRUʱ򣬴headprevңԽȱʵԽǳʱûʹõģΪreleaseĿ뵽head.nextҲprevĵط
-    if(b->refcnt == 0) {  // 𻺳ĻҲֻüΪ0Ŀ
+    // Dirty buffers hold logged data whose home block has not been
+    // written yet; checkpoint() in log.c cleans them.
+    if(b->refcnt == 0 && !b->dirty) {  // 𻺳ĻҲֻüΪ0Ŀ
       b->dev = dev;
       b->blockno = blockno;
       b->valid = 0;
       b->refcnt = 1;
+      bcache.misses++;
       release(&bcache.lock);
       acquiresleep(&b->lock);
       return b;
@@ -97,6 +104,7 @@ bread(uint dev, uint blockno)
   struct buf *b;
 
   b = bget(dev, blockno);
+  KTRACE(KT_BREAD, blockno, b->valid);
   if(!b->valid) {  // Ǹշ
     virtio_disk_rw(b, 0);
     b->valid = 1;
@@ -104,6 +112,18 @@ bread(uint dev, uint blockno)
   return b;
 }
 
+// Return a locked buf for a block the caller is about to overwrite
+// completely, without reading its old contents from disk.
+struct buf*
+bgetblk(uint dev, uint blockno)
+{
+  struct buf *b;
+
+  b = bget(dev, blockno);
+  b->valid = 1;
+  return b;
+}
+
 // Write b's contents to disk.  Must be locked.
 // bwriteǰblock cacheʵд̵ĺ
 void
@@ -111,9 +131,25 @@ bwrite(struct buf *b)
 {
   if(!holdingsleep(&b->lock))
     panic("bwrite");
+  KTRACE(KT_BWRITE, b->blockno, 0);
   virtio_disk_rw(b, 1);
 }
 
+// Write n locked bufs as one batch of disk requests,
+// bs[i]'s contents going to disk block blocknos[i].
+void
+bwritev(struct buf **bs, uint *blocknos, int n)
+{
+  int i;
+
+  for(i = 0; i < n; i++){
+    if(!holdingsleep(&bs[i]->lock))
+      panic("bwritev");
+    KTRACE(KT_BWRITE, blocknos[i], 0);
+  }
+  virtio_disk_rwv(bs, blocknos, n, 1);
+}
+
 // Release a locked buffer.
 // Move to the head of the most-recently-used list.
 // ͷһ黺
@@ -141,17 +177,10 @@ brelse(struct buf *b)
 }
 
 void
-bpin(struct buf *b) {
-  acquire(&bcache.lock);
-  b->refcnt++;
-  release(&bcache.lock);
-}
-
-void
-bunpin(struct buf *b) {
+bstats(struct kstats *ks)
+{
   acquire(&bcache.lock);
-  b->refcnt--;
+  ks->bhits = bcache.hits;
+  ks->bmisses = bcache.misses;
   release(&bcache.lock);
 }
-
-
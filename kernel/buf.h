@@ -1,6 +1,10 @@
 struct buf {
   int valid;   // has data been read from disk?
   int disk;    // does disk "own" buf?
+  int dirty;   // logged, but home block not yet written
+  uint qblock;       // disk block to transfer to/from (virtio queue)
+  int qwrite;        // queued for a write?
+  struct buf *qnext; // virtio pending queue / request chain
   uint dev;    // 豸
   uint blockno;  // ̿
   struct sleeplock lock;
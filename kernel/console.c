@@ -17,6 +17,7 @@
 #include "sleeplock.h"
 #include "fs.h"
 #include "file.h"
+#include "fcntl.h"
 #include "memlayout.h"
 #include "riscv.h"
 #include "defs.h"
@@ -26,18 +27,19 @@
 #define C(x)  ((x)-'@')  // Control-x
 
 //
-// send one character to the uart.
-// called by printf, and to echo input characters,
-// but not from write().
+// send one character to the uart, without sleeping.
+// called to echo input characters, but not from write().
 //
 void
 consputc(int c)
 {
+  char ch = c;
+
   if(c == BACKSPACE){  // c˸
     // if the user typed backspace, overwrite with a space.
-    uartputc_sync('\b'); uartputc_sync(' '); uartputc_sync('\b'); // '\b'ǽһȻÿո񸲸Ҫ˸ַȻٻ˹
+    uartputs("\b \b", 3); // '\b'ǽһȻÿո񸲸Ҫ˸ַȻٻ˹
   } else {
-    uartputc_sync(c);
+    uartputs(&ch, 1);
   }
 }
 
@@ -50,6 +52,7 @@ struct {
   uint r;  // Read index
   uint w;  // Write index
   uint e;  // Edit index
+  struct epitem *watch;  // epoll items watching input
 } cons;  // ʾ̨Ϣ״̬
 
 //
@@ -58,16 +61,18 @@ struct {
 int
 consolewrite(int user_src, uint64 src, int n)  //srcȡnַдconsoleuser_srcָʾsrcûַں˵ַ
 {
-  int i;
-
-  acquire(&cons.lock);
-  for(i = 0; i < n; i++){
-    char c;
-    if(either_copyin(&c, user_src, src+i, 1) == -1)  // ַsrcжȡһַŵc
+  char buf[128];
+  int i, m, k;
+
+  // copy a chunk at a time, and hand the UART as
+  // much of each as its buffer has room for.
+  for(i = 0; i < n; i += m){
+    m = n - i < sizeof(buf) ? n - i : sizeof(buf);
+    if(either_copyin(buf, user_src, src+i, m) == -1)  // ַsrc+iжȡmַŵbuf
       break;
-    uartputc(c);  // ѶַcUARTĻ첽ʾ
+    for(k = 0; k < m; )
+      k += uartwrite(buf + k, m - k);  // bufUARTĻ첽ʾ
   }
-  release(&cons.lock);
 
   return i;
 }
@@ -91,7 +96,7 @@ consoleread(int user_dst, uint64 dst, int n)  // 
     // wait until interrupt handler has put some
     // input into cons.buffer.
     while(cons.r == cons.w){  // ûַߵȴ
-      if(myproc()->killed){
+      if(iokilled()){
         release(&cons.lock);
         return -1;
       }
@@ -142,6 +147,7 @@ consoleintr(int c)   // 
   switch(c){
   case C('P'):  // Print process list.
     procdump();
+    virtio_disk_dump();
     break;
   case C('U'):  // Kill line.
     while(cons.e != cons.w &&
@@ -172,6 +178,7 @@ consoleintr(int c)   // 
         // has arrived.
         cons.w = cons.e;
         wakeup(&cons.r);
+        epnotify(&cons.watch, POLLIN);
       }
     }
     break;
@@ -180,6 +187,21 @@ consoleintr(int c)   // 
   release(&cons.lock);
 }
 
+// Input is readable once a whole line (or ^D) has arrived,
+// which is also when consoleintr() wakes readers.
+int
+consolepoll(void **chan)
+{
+  int mask = POLLOUT;
+
+  acquire(&cons.lock);
+  if(cons.r != cons.w)
+    mask |= POLLIN;
+  release(&cons.lock);
+  chan[0] = &cons.r;
+  return mask;
+}
+
 void
 consoleinit(void)
 {
@@ -191,4 +213,6 @@ consoleinit(void)
   // to consoleread and consolewrite.
   devsw[CONSOLE].read = consoleread;
   devsw[CONSOLE].write = consolewrite;
+  devsw[CONSOLE].poll = consolepoll;
+  devsw[CONSOLE].watch = &cons.watch;
 }
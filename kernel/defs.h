@@ -1,27 +1,44 @@
 struct buf;
 struct context;
+struct epitem;
+struct epoll;
 struct file;
 struct inode;
+struct kstats;
+struct iovec;
 struct pipe;
 struct proc;
 struct spinlock;
 struct sleeplock;
 struct stat;
 struct superblock;
+struct timer;
+
+// aio.c
+void            aioinit(void);
+void            aioexit(struct proc*);
+int             aiobusy(struct proc*);
 
 // bio.c
 void            binit(void);
 struct buf*     bread(uint, uint);
+struct buf*     bgetblk(uint, uint);
 void            brelse(struct buf*);
 void            bwrite(struct buf*);
-void            bpin(struct buf*);
-void            bunpin(struct buf*);
+void            bwritev(struct buf**, uint*, int);
+void            bstats(struct kstats*);
 
 // console.c
 void            consoleinit(void);
 void            consoleintr(int);
 void            consputc(int);
 
+// epoll.c
+void            epollinit(void);
+void            epnotify(struct epitem**, int);
+void            epforget(struct file*);
+void            epclose(struct epoll*);
+
 // exec.c
 int             exec(char*, char**);
 
@@ -31,8 +48,12 @@ void            fileclose(struct file*);
 struct file*    filedup(struct file*);
 void            fileinit(void);
 int             fileread(struct file*, uint64, int n);
+int             filereadv(struct file*, struct iovec*, int, int);
+int             filesplice(struct file*, struct file*, int);
+int             filepoll(struct file*, void**);
 int             filestat(struct file*, uint64 addr);
 int             filewrite(struct file*, uint64, int n);
+int             filewritev(struct file*, struct iovec*, int, int);
 
 // fs.c
 void            fsinit(int);
@@ -41,6 +62,7 @@ struct inode*   dirlookup(struct inode*, char*, uint*);
 struct inode*   ialloc(uint, short);
 struct inode*   idup(struct inode*);
 void            iinit();
+struct buf*     ibread(struct inode*, uint);
 void            ilock(struct inode*);
 void            iput(struct inode*);
 void            iunlock(struct inode*);
@@ -54,6 +76,9 @@ void            stati(struct inode*, struct stat*);
 int             writei(struct inode*, int, uint64, uint, uint);
 void            itrunc(struct inode*);
 
+// futex.c
+void            futexinit(void);
+
 // ramdisk.c
 void            ramdiskinit(void);
 void            ramdiskintr(void);
@@ -63,32 +88,59 @@ void            ramdiskrw(struct buf*);
 void*           kalloc(void);
 void            kfree(void *);
 void            kinit(void);
+void            kmemstats(struct kstats*);
+
+// membench.c
+void            membench(void);
+
+// klog.c
+void            klogwrite(char*, int);
+int             klogtake(char*, int);
+
+// ktrace.c
+extern volatile int ktmask;
+void            ktraceinit(void);
+void            ktrec(int, uint64, uint64);
 
 // log.c
 void            initlog(int, struct superblock*);
 void            log_write(struct buf*);
 void            begin_op(void);
 void            end_op(void);
+void            log_force(void);
+void            logstats(struct kstats*);
 
 // pipe.c
 int             pipealloc(struct file**, struct file**);
 void            pipeclose(struct pipe*, int);
 int             piperead(struct pipe*, uint64, int);
 int             pipewrite(struct pipe*, uint64, int);
+int             pipewait(struct pipe*, int);
+int             pipesize(struct pipe*);
+int             piperesize(struct pipe*, int);
+int             pipepoll(struct pipe*, void**);
+struct epitem** pipewatch(struct pipe*);
+int             pipecopy(struct pipe*, char*, int, int);
+void            pipestats(struct kstats*);
 
 // printf.c
 void            printf(char*, ...);
 void            panic(char*) __attribute__((noreturn));
-void            printfinit(void);
 
 // proc.c
 int             cpuid(void);
 void            exit(int);
 int             fork(void);
+int             clone(uint64, uint64, uint64);
+int             join(int, uint64);
+struct inode*   cwdup(struct proc*);
 int             growproc(int);
 pagetable_t     proc_pagetable(struct proc *);
 void            proc_freepagetable(pagetable_t, uint64);
 int             kill(int);
+int             iokilled(void);
+int             procsysstat(int, int, uint64*, uint64*);
+int             kthread(void (*)(void), char*);
 struct cpu*     mycpu(void);
 struct cpu*     getmycpu(void);
 struct proc*    myproc();
@@ -101,9 +153,22 @@ void            userinit(void);
 int             wait(uint64);
 void            wakeup(void*);
 void            yield(void);
+int             schedtick(void);
+void            mlfqboost(void);
+int             setpriority(int, int);
 int             either_copyout(int user_dst, uint64 dst, void *src, uint64 len);
 int             either_copyin(void *dst, int user_src, uint64 src, uint64 len);
 void            procdump(void);
+void            procstats(struct kstats*);
+void            pollstart(void**, int);
+void            pollsleep(void);
+void            pollend(void);
+
+// prof.c
+extern int      profiling;
+extern uint64   profcycles;
+void            profinit(void);
+void            profsample(void);
 
 // swtch.S
 void            swtch(struct context*, struct context*);
@@ -123,6 +188,8 @@ int             holdingsleep(struct sleeplock*);
 void            initsleeplock(struct sleeplock*, char*);
 
 // string.c
+void            copy_page(void*, const void*);
+void            zero_page(void*);
 int             memcmp(const void*, const void*, uint);
 void*           memmove(void*, const void*, uint);
 void*           memset(void*, int, uint);
@@ -131,6 +198,11 @@ int             strlen(const char*);
 int             strncmp(const char*, const char*, uint);
 char*           strncpy(char*, const char*, int);
 
+// sysfile.c
+struct file*    fileopen(char*, int);
+int             fdinstall(struct proc*, struct file*);
+struct file*    fdget(int);
+
 // syscall.c
 int             argint(int, int*);
 int             argstr(int, char*, int);
@@ -139,18 +211,36 @@ int             fetchstr(uint64, char*, int);
 int             fetchaddr(uint64, uint64*);
 void            syscall();
 
+// stats.c
+void            statsinit(void);
+
+// sysstat.c
+void            sysstatrec(struct proc*, int, uint64);
+
+// timer.c
+void            timerqinit(void);
+uint            uptime(void);
+void            timerset(struct timer*, uint64);
+void            timercancel(struct timer*);
+int             sleepuntil(uint64);
+void            tickstart(void);
+int             timerintr(void);
+void            setidle(int);
+void            kickidle(void);
+void            timerstats(struct kstats*);
+
 // trap.c
-extern uint     ticks;
-void            trapinit(void);
 void            trapinithart(void);
-extern struct spinlock tickslock;
 void            usertrapret(void);
 
 // uart.c
 void            uartinit(void);
 void            uartintr(void);
-void            uartputc(int);
-void            uartputc_sync(int);
+int             uartwrite(char*, int);
+void            uartputs(char*, int);
+void            uartflush(char*, int);
+void            uartkick(void);
+void            uartpoll(void);
 int             uartgetc(void);
 
 // vm.c
@@ -181,7 +271,10 @@ void            plic_complete(int);
 // virtio_disk.c
 void            virtio_disk_init(void);
 void            virtio_disk_rw(struct buf *, int);
+void            virtio_disk_rwv(struct buf **, uint *, int, int);
 void            virtio_disk_intr(void);
+void            virtio_disk_dump(void);
+void            virtio_disk_stats(struct kstats*);
 
 // number of elements in fixed-size array
 #define NELEM(x) (sizeof(x)/sizeof((x)[0]))
@@ -0,0 +1,349 @@
+//
+// epoll: an FD_EPOLL file holds a set of watched descriptors.
+// Each watched pipe or device keeps a list of the items watching
+// it and calls epnotify() when its readiness changes, which puts
+// the items on their epoll's ready list. epoll_wait() only looks
+// at that list, so its cost follows the number of events rather
+// than the number of watched descriptors.
+//
+
+#include "types.h"
+#include "riscv.h"
+#include "defs.h"
+#include "param.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "fs.h"
+#include "sleeplock.h"
+#include "file.h"
+#include "fcntl.h"
+#include "epoll.h"
+#include "memlayout.h"
+#include "timer.h"
+
+#define NEPITEM 32  // descriptors per epoll
+
+struct epitem {
+  struct epoll *ep;
+  struct file *f;         // watched file (no reference), 0 if free
+  int fd;
+  int events;             // wanted events, plus POLLHUP
+  int revents;            // events seen since the last report
+  uint64 data;
+  int ready;              // on ep's ready list?
+  struct epitem *rnext;   // ep's ready list
+  struct epitem *wnext;   // list of the items watching f's pipe or device
+  struct epitem **whead;  // head of that list, or 0
+};
+
+struct epoll {
+  struct epitem item[NEPITEM];
+  struct epitem *ready;   // reported by the next epoll_wait()
+  struct epitem **rtail;
+};
+
+// eplock protects every epoll and every watch list.
+// Lock order: pipe and console locks, then ftable.lock,
+// then eplock, then proc locks (in wakeup()).
+struct spinlock eplock;
+
+void
+epollinit(void)
+{
+  initlock(&eplock, "epoll");
+}
+
+// The head of the list of items watching f's pipe or device,
+// or 0 if f can't notify.
+static struct epitem**
+watchhead(struct file *f)
+{
+  if(f->type == FD_PIPE)
+    return pipewatch(f->pipe);
+  if(f->type == FD_DEVICE && f->major >= 0 && f->major < NDEV)
+    return devsw[f->major].watch;
+  return 0;
+}
+
+// Record events on it and queue it for epoll_wait().
+// Caller holds eplock.
+static void
+epready(struct epitem *it, int events)
+{
+  struct epoll *ep = it->ep;
+
+  if((events &= it->events) == 0)
+    return;
+  it->revents |= events;
+  if(!it->ready){
+    it->ready = 1;
+    it->rnext = 0;
+    *ep->rtail = it;
+    ep->rtail = &it->rnext;
+    wakeup(ep);
+  }
+}
+
+// Called by a pipe or device when events (POLL* bits) have
+// just become true for it. head is its list of watchers.
+void
+epnotify(struct epitem **head, int events)
+{
+  struct epitem *it;
+
+  if(*head == 0)  // nobody watching; the common case
+    return;
+  acquire(&eplock);
+  for(it = *head; it; it = it->wnext)
+    epready(it, events);
+  release(&eplock);
+}
+
+// Take it off its watch list and ready list, and free it.
+// Caller holds eplock.
+static void
+epunlink(struct epitem *it)
+{
+  struct epitem **pp;
+  struct epoll *ep = it->ep;
+
+  if(it->whead){
+    for(pp = it->whead; *pp != it; pp = &(*pp)->wnext)
+      ;
+    *pp = it->wnext;
+  }
+  if(it->ready){
+    for(pp = &ep->ready; *pp != it; pp = &(*pp)->rnext)
+      ;
+    if((*pp = it->rnext) == 0)
+      ep->rtail = pp;
+  }
+  it->f = 0;
+  it->ready = 0;
+  it->whead = 0;
+}
+
+// f is being freed: stop every epoll from watching it.
+// Called by fileclose() with ftable.lock held.
+void
+epforget(struct file *f)
+{
+  struct epitem **head, *it, *next;
+
+  if((head = watchhead(f)) == 0 || *head == 0)
+    return;
+  acquire(&eplock);
+  for(it = *head; it; it = next){
+    next = it->wnext;
+    if(it->f == f)
+      epunlink(it);
+  }
+  release(&eplock);
+}
+
+// The last reference to an FD_EPOLL file is gone.
+void
+epclose(struct epoll *ep)
+{
+  acquire(&eplock);
+  for(int i = 0; i < NEPITEM; i++)
+    if(ep->item[i].f)
+      epunlink(&ep->item[i]);
+  release(&eplock);
+  kfree((char*)ep);
+}
+
+uint64
+sys_epoll_create(void)
+{
+  struct file *f;
+  struct epoll *ep;
+  int fd;
+
+  if((ep = (struct epoll*)kalloc()) == 0)
+    return -1;
+  memset(ep, 0, sizeof(*ep));
+  ep->rtail = &ep->ready;
+  for(int i = 0; i < NEPITEM; i++)
+    ep->item[i].ep = ep;
+  if((f = filealloc()) == 0){
+    kfree((char*)ep);
+    return -1;
+  }
+  f->type = FD_EPOLL;
+  f->readable = 0;  // only epoll_wait() reads it
+  f->writable = 0;
+  f->nonblock = 0;
+  f->ep = ep;
+  if((fd = fdinstall(myproc(), f)) < 0){
+    fileclose(f);
+    return -1;
+  }
+  return fd;
+}
+
+// The FD_EPOLL file for the epoll descriptor in argument n,
+// which the caller must fileclose() (see fdget()).
+static struct file*
+argep(int n)
+{
+  int fd;
+  struct file *f;
+
+  if(argint(n, &fd) < 0 || (f = fdget(fd)) == 0)
+    return 0;
+  if(f->type != FD_EPOLL){
+    fileclose(f);
+    return 0;
+  }
+  return f;
+}
+
+// Add, change or remove the item of ep for descriptor fd,
+// open as f.
+static int
+epctl(struct epoll *ep, int op, int fd, struct file *f, uint64 uev)
+{
+  struct epitem *it, *slot;
+  struct epoll_event ev;
+  void *chan[2];
+  int mask;
+
+  if(f->type == FD_EPOLL)
+    return -1;
+  if(op != EPOLL_CTL_DEL &&
+     copyin(myproc()->pagetable, (char*)&ev, uev, sizeof(ev)) < 0)
+    return -1;
+
+  acquire(&eplock);
+  slot = 0;
+  for(it = ep->item; it < &ep->item[NEPITEM]; it++){
+    if(it->f == f && it->fd == fd)
+      break;
+    if(it->f == 0 && slot == 0)
+      slot = it;
+  }
+  if(it == &ep->item[NEPITEM])
+    it = 0;
+
+  if(op == EPOLL_CTL_DEL || op == EPOLL_CTL_MOD){
+    if(it == 0){
+      release(&eplock);
+      return -1;
+    }
+    if(op == EPOLL_CTL_DEL){
+      epunlink(it);
+      release(&eplock);
+      return 0;
+    }
+    it->events = ev.events | POLLHUP;
+    it->data = ev.data;
+    release(&eplock);
+  } else if(op == EPOLL_CTL_ADD){
+    if(it != 0 || (it = slot) == 0){
+      release(&eplock);
+      return -1;
+    }
+    it->f = f;
+    it->fd = fd;
+    it->events = ev.events | POLLHUP;
+    it->revents = 0;
+    it->data = ev.data;
+    if((it->whead = watchhead(f)) != 0){
+      it->wnext = *it->whead;
+      *it->whead = it;
+    }
+    release(&eplock);
+  } else {
+    release(&eplock);
+    return -1;
+  }
+
+  // report what is already true. the item is registered
+  // first, so a change from here on is not missed either.
+  mask = filepoll(f, chan);
+  acquire(&eplock);
+  if(it->f == f)
+    epready(it, mask);
+  release(&eplock);
+  return 0;
+}
+
+// epoll_ctl(epfd, op, fd, event)
+uint64
+sys_epoll_ctl(void)
+{
+  struct file *epf, *f;
+  uint64 uev;
+  int op, fd, r;
+
+  if(argint(1, &op) < 0 || argint(2, &fd) < 0 || argaddr(3, &uev) < 0 ||
+     (epf = argep(0)) == 0)
+    return -1;
+  if((f = fdget(fd)) == 0){
+    fileclose(epf);
+    return -1;
+  }
+  r = epctl(epf->ep, op, fd, f, uev);
+  fileclose(f);
+  fileclose(epf);
+  return r;
+}
+
+// epoll_wait(epfd, events, max, timeout): wait until events are
+// ready or timeout ticks pass (never if timeout < 0). Fills in
+// up to max events and returns how many.
+uint64
+sys_epoll_wait(void)
+{
+  struct proc *p = myproc();
+  struct file *epf;
+  struct epoll *ep;
+  struct epitem *it;
+  struct epoll_event ev[NEPITEM];
+  void *chan[2];
+  struct timer t;
+  uint64 uev;
+  int n, max, timeout, expired;
+
+  if(argaddr(1, &uev) < 0 || argint(2, &max) < 0 || argint(3, &timeout) < 0 ||
+     max <= 0 || (epf = argep(0)) == 0)
+    return -1;
+  ep = epf->ep;
+  if(max > NEPITEM)
+    max = NEPITEM;
+
+  if(timeout > 0)
+    timerset(&t, r_time() + (uint64)timeout * TICKCYCLES);
+  chan[0] = ep;
+  chan[1] = &t;
+  for(;;){
+    pollstart(chan, timeout > 0 ? 2 : 1);
+    n = 0;
+    acquire(&eplock);
+    while(n < max && (it = ep->ready) != 0){
+      if((ep->ready = it->rnext) == 0)
+        ep->rtail = &ep->ready;
+      it->ready = 0;
+      ev[n].events = it->revents;
+      ev[n].pad = 0;
+      ev[n].data = it->data;
+      it->revents = 0;
+      n++;
+    }
+    release(&eplock);
+    expired = timeout == 0 || (timeout > 0 && t.fired);
+    if(n > 0 || expired || p->killed){
+      pollend();
+      break;
+    }
+    pollsleep();
+  }
+  if(timeout > 0)
+    timercancel(&t);
+  fileclose(epf);
+
+  if(p->killed || copyout(p->pagetable, uev, (char*)ev, n*sizeof(ev[0])) < 0)
+    return -1;
+  return n;
+}
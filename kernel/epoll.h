@@ -0,0 +1,15 @@
+// Event notification for many descriptors (epoll_create() etc.).
+// Events are the POLL* bits from fcntl.h, and are edge-triggered:
+// epoll_wait() reports a descriptor once per change in readiness,
+// plus once when it is added if it is ready then.
+
+// epoll_ctl() operations.
+#define EPOLL_CTL_ADD  1
+#define EPOLL_CTL_DEL  2
+#define EPOLL_CTL_MOD  3
+
+struct epoll_event {
+  int events;     // POLLIN, POLLOUT; POLLHUP is always reported
+  int pad;
+  uint64 data;    // handed back by epoll_wait()
+};
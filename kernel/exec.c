@@ -21,6 +21,10 @@ exec(char *path, char **argv)
   pagetable_t pagetable = 0, oldpagetable;
   struct proc *p = myproc();
 
+  // the other threads would be left running in the old image.
+  if(p->leader != p || p->nthread > 0)
+    return -1;
+
   begin_op();
 
   if((ip = namei(path)) == 0){
@@ -115,6 +119,7 @@ exec(char *path, char **argv)
   safestrcpy(p->name, last, sizeof(p->name));
     
   // Commit to the user image. ύû̾
+  aioexit(p);
   oldpagetable = p->pagetable;
   p->pagetable = pagetable;
   p->sz = sz;
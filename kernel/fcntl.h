@@ -3,3 +3,35 @@
 #define O_RDWR    0x002
 #define O_CREATE  0x200
 #define O_TRUNC   0x400  // ļݣʹļڿ״̬
+#define O_NONBLOCK 0x800  // reads of an empty pipe or console fail at once
+
+// fcntl() commands.
+#define F_GETPIPE_SZ  1  // size of a pipe's buffer
+#define F_SETPIPE_SZ  2  // resize a pipe's buffer to arg bytes
+#define F_GETFL       3  // open mode and O_NONBLOCK
+#define F_SETFL       4  // set O_NONBLOCK from arg
+
+// lseek() whence values.
+#define SEEK_SET  0
+#define SEEK_CUR  1
+#define SEEK_END  2
+
+// one buffer for readv() and writev().
+struct iovec {
+  void *iov_base;
+  uint iov_len;
+};
+
+#define IOV_MAX   16  // most buffers per readv()/writev()
+
+// poll() events.
+#define POLLIN    0x01  // read won't block
+#define POLLOUT   0x04  // write won't block
+#define POLLHUP   0x10  // other end of the pipe closed
+#define POLLNVAL  0x20  // fd not open
+
+struct pollfd {
+  int fd;
+  short events;   // requested
+  short revents;  // returned
+};
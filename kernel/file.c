@@ -9,9 +9,11 @@
 #include "fs.h"
 #include "spinlock.h"
 #include "sleeplock.h"
+#include "buf.h"
 #include "file.h"
 #include "stat.h"
 #include "proc.h"
+#include "fcntl.h"
 
 struct devsw devsw[NDEV];  //devsw[i]װ˿Զһ豸ʩӵвNDEVxv6е豸ţֵΪ10
 //Xv6ڲֻ֧ע10ֲͬ豸(ʵֻconsoleһ)ÿһ豸ֶֻ֧дֲ
@@ -73,6 +75,7 @@ fileclose(struct file *f)
     return;
   }
   // е˵file.ref0ˣinoderefһ0Ҫiputһinodeü
+  epforget(f);  // before the slot can be reused
   ff = *f;  // *fݸƵff
   f->ref = 0;
   f->type = FD_NONE;
@@ -80,6 +83,8 @@ fileclose(struct file *f)
 
   if(ff.type == FD_PIPE){  // ԭFD_PIPEpipecloseرչܵ
     pipeclose(ff.pipe, ff.writable);
+  } else if(ff.type == FD_EPOLL){
+    epclose(ff.ep);
   } else if(ff.type == FD_INODE || ff.type == FD_DEVICE){  // ԭFD_INODEFD_DEVICEһinodeü
     begin_op();
     iput(ff.ip);
@@ -107,84 +112,301 @@ filestat(struct file *f, uint64 addr)
   return -1;
 }
 
-// Read from file f.
-// addr is a user virtual address.
-// ļfӦļжȡnַַaddr
+// Report which of POLLIN, POLLOUT and POLLHUP hold for f, and
+// store in chan[0..1] the channels woken when that may change.
+// Inodes, and devices without a poll function, never block.
 int
-fileread(struct file *f, uint64 addr, int n)
+filepoll(struct file *f, void **chan)
+{
+  int mask;
+
+  chan[0] = chan[1] = 0;
+  if(f->type == FD_PIPE)
+    mask = pipepoll(f->pipe, chan);
+  else if(f->type == FD_DEVICE && f->major >= 0 && f->major < NDEV &&
+          devsw[f->major].poll)
+    mask = devsw[f->major].poll(chan);
+  else
+    mask = POLLIN | POLLOUT;
+  if(f->readable == 0)
+    mask &= ~POLLIN;
+  if(f->writable == 0)
+    mask &= ~POLLOUT;
+  return mask;
+}
+
+// Read from file f into the niov user buffers described by iov.
+// Inodes are read at offset off, or at f->off (advancing it) if
+// off is negative; pipes and devices have no offset.
+// ļfӦļζiovĸû
+int
+filereadv(struct file *f, struct iovec *iov, int niov, int off)
 {
-  int r = 0;
+  int i, r = 0, tot = 0;
+  uint o;
+  void *chan[2];
 
   if(f->readable == 0)  // жǷɶ
     return -1;
+  if(off >= 0 && f->type != FD_INODE)
+    return -1;
+  if(f->nonblock && (filepoll(f, chan) & POLLIN) == 0)
+    return -1;  // would block
 
-  if(f->type == FD_PIPE){  // ܵ
-    r = piperead(f->pipe, addr, n);
-  } else if(f->type == FD_DEVICE){   // 豸ļ
-    if(f->major < 0 || f->major >= NDEV || !devsw[f->major].read)
+  if(f->type == FD_PIPE || f->type == FD_DEVICE){  // ܵ豸ļ
+    if(f->type == FD_DEVICE &&
+       (f->major < 0 || f->major >= NDEV || !devsw[f->major].read))
       return -1;
-    r = devsw[f->major].read(1, addr, n);
+    for(i = 0; i < niov; i++){
+      if(f->type == FD_PIPE)
+        r = piperead(f->pipe, (uint64)iov[i].iov_base, iov[i].iov_len);
+      else
+        r = devsw[f->major].read(1, (uint64)iov[i].iov_base, iov[i].iov_len);
+      if(r < 0)
+        return tot > 0 ? tot : -1;
+      tot += r;
+      if(r < iov[i].iov_len)  // don't wait for more
+        break;
+    }
   } else if(f->type == FD_INODE){  // inode
     ilock(f->ip);
-    if((r = readi(f->ip, 1, addr, f->off, n)) > 0)
-      f->off += r;
+    o = off >= 0 ? off : f->off;
+    for(i = 0; i < niov; i++){
+      if((r = readi(f->ip, 1, (uint64)iov[i].iov_base, o, iov[i].iov_len)) < 0)
+        break;
+      o += r;
+      tot += r;
+      if(r < iov[i].iov_len)  // end of file
+        break;
+    }
+    if(off < 0)
+      f->off = o;
     iunlock(f->ip);
+    if(r < 0 && tot == 0)
+      return -1;
   } else {
     panic("fileread");
   }
 
-  return r;
+  return tot;
 }
 
-// Write to file f.
+// Read from file f.
 // addr is a user virtual address.
+// ļfӦļжȡnַַaddr
+int
+fileread(struct file *f, uint64 addr, int n)
+{
+  struct iovec iov;
+
+  iov.iov_base = (void*)addr;
+  iov.iov_len = n;
+  return filereadv(f, &iov, 1, -1);
+}
+
+// Write the niov user buffers described by iov to file f,
+// at offset off, or at f->off (advancing it) if off is negative.
+// Returns the total byte count, or -1 if not all of it was written.
 // ݴļѡͬд
 int
-filewrite(struct file *f, uint64 addr, int n)
+filewritev(struct file *f, struct iovec *iov, int niov, int off)
 {
-  int r, ret = 0;
+  int i, r, n1, room, done, tot = 0, want = 0;
+  uint o;
 
   if(f->writable == 0)  // жǷд
     return -1;
+  if(off >= 0 && f->type != FD_INODE)
+    return -1;
+  for(i = 0; i < niov; i++)
+    want += iov[i].iov_len;
 
-  if(f->type == FD_PIPE){  // ǹܵ
-    ret = pipewrite(f->pipe, addr, n);
-  } else if(f->type == FD_DEVICE){  // 豸ļ
-    if(f->major < 0 || f->major >= NDEV || !devsw[f->major].write)
+  if(f->type == FD_PIPE || f->type == FD_DEVICE){  // ܵ豸ļ
+    if(f->type == FD_DEVICE &&
+       (f->major < 0 || f->major >= NDEV || !devsw[f->major].write))
       return -1;
-    ret = devsw[f->major].write(1, addr, n);
+    for(i = 0; i < niov; i++){
+      if(f->type == FD_PIPE)
+        r = pipewrite(f->pipe, (uint64)iov[i].iov_base, iov[i].iov_len);
+      else
+        r = devsw[f->major].write(1, (uint64)iov[i].iov_base, iov[i].iov_len);
+      if(r < 0)
+        return -1;
+      tot += r;
+      if(r < iov[i].iov_len)
+        break;
+    }
+    return tot;
   } else if(f->type == FD_INODE){  // inode
     // write a few blocks at a time to avoid exceeding
     // the maximum log transaction size, including
     // i-node, indirect block, allocation blocks,
     // and 2 blocks of slop for non-aligned writes.
+    // the bytes written by one transaction are contiguous
+    // in the file, so as many buffers as fit share it.
     // this really belongs lower down, since writei()
     // might be writing a device like the console.
-    int max = ((MAXOPBLOCKS-1-1-2) / 2) * BSIZE;  // һдֽ
-    int i = 0;
-    while(i < n){  // ʹwhileѭnֽڷд
-      int n1 = n - i;
-      if(n1 > max)
-        n1 = max;
-
+    int max = ((MAXOPBLOCKS-1-1-2) / 2) * BSIZE;  // һдֽ
+    i = 0;
+    done = 0;  // bytes of iov[i] already written
+    r = 0;
+    o = off >= 0 ? off : f->off;
+    while(i < niov && r >= 0){  // ʹwhileѭд
       begin_op();
       ilock(f->ip);
-      if ((r = writei(f->ip, 1, addr + i, f->off, n1)) > 0)
-        f->off += r;
+      if(off < 0)
+        o = f->off;
+      for(room = max; i < niov && room > 0; room -= r){
+        n1 = iov[i].iov_len - done;
+        if(n1 > room)
+          n1 = room;
+        if((r = writei(f->ip, 1, (uint64)iov[i].iov_base + done, o, n1)) < 0)
+          break;
+        if(r != n1)
+          panic("short filewrite");
+        o += r;
+        tot += r;
+        if((done += r) == iov[i].iov_len){
+          i++;
+          done = 0;
+        }
+      }
+      if(off < 0)
+        f->off = o;
       iunlock(f->ip);
       end_op();
-
-      if(r < 0)
-        break;
-      if(r != n1)
-        panic("short filewrite");
-      i += r;
     }
-    ret = (i == n ? n : -1);
   } else {
     panic("filewrite");
   }
 
-  return ret;
+  return tot == want ? tot : -1;
 }
 
+// Write to file f.
+// addr is a user virtual address.
+int
+filewrite(struct file *f, uint64 addr, int n)
+{
+  struct iovec iov;
+
+  iov.iov_base = (void*)addr;
+  iov.iov_len = n;
+  return filewritev(f, &iov, 1, -1);
+}
+
+// Move up to n bytes from inode file in to a pipe or device,
+// straight out of the buffer cache.
+static int
+splicefrom(struct file *in, struct file *out, int n)
+{
+  struct inode *ip = in->ip;
+  struct buf *bp;
+  char *p;
+  int m, r, tot = 0;
+
+  if(out->type == FD_DEVICE &&
+     (out->major < 0 || out->major >= NDEV || !devsw[out->major].write))
+    return -1;
+
+  while(tot < n){
+    m = n - tot;
+    if(out->type == FD_PIPE){
+      // wait for room before taking any locks.
+      if((r = pipewait(out->pipe, 1)) < 0)
+        return tot > 0 ? tot : -1;
+      if(m > r)
+        m = r;
+    }
+    ilock(ip);
+    if(in->off >= ip->size){
+      iunlock(ip);
+      break;
+    }
+    if(m > ip->size - in->off)
+      m = ip->size - in->off;
+    if(m > BSIZE - in->off % BSIZE)
+      m = BSIZE - in->off % BSIZE;
+    bp = ibread(ip, in->off);
+    p = (char*)bp->data + in->off % BSIZE;
+    if(out->type == FD_PIPE)
+      r = pipecopy(out->pipe, p, m, 1);
+    else
+      r = devsw[out->major].write(0, (uint64)p, m);
+    brelse(bp);
+    if(r > 0)
+      in->off += r;
+    iunlock(ip);
+    if(r < 0 || (out->type == FD_DEVICE && r < m))
+      break;
+    tot += r;
+  }
+  return tot;
+}
+
+// Move up to n bytes from pipe file in to inode file out,
+// straight into the buffer cache.
+static int
+spliceto(struct file *in, struct file *out, int n)
+{
+  struct inode *ip = out->ip;
+  struct buf *bp;
+  int m, c, r, done, tot = 0;
+  // same per-transaction limit as filewritev().
+  int max = ((MAXOPBLOCKS-1-1-2) / 2) * BSIZE;
+
+  while(tot < n){
+    // wait for data outside the transaction.
+    if((m = pipewait(in->pipe, 0)) <= 0)
+      return m < 0 && tot == 0 ? -1 : tot;
+    if(m > n - tot)
+      m = n - tot;
+    if(m > max)
+      m = max;
+
+    begin_op();
+    ilock(ip);
+    if(out->off > ip->size || out->off + m > MAXFILE*BSIZE){
+      iunlock(ip);
+      end_op();
+      return tot > 0 ? tot : -1;
+    }
+    for(done = 0; done < m; done += r){
+      c = m - done;
+      if(c > BSIZE - out->off % BSIZE)
+        c = BSIZE - out->off % BSIZE;
+      bp = ibread(ip, out->off);
+      r = pipecopy(in->pipe, (char*)bp->data + out->off % BSIZE, c, 0);
+      log_write(bp);
+      brelse(bp);
+      out->off += r;
+      if(r < c){  // another reader took some of the data
+        done += r;
+        break;
+      }
+    }
+    if(out->off > ip->size)
+      ip->size = out->off;
+    iupdate(ip);
+    iunlock(ip);
+    end_op();
+    tot += done;
+  }
+  return tot;
+}
+
+// Move up to n bytes from file in to file out without copying
+// through user space: from an inode to a pipe or device, or from
+// a pipe to an inode. Returns the number of bytes moved, 0 at the
+// end of in, or -1.
+int
+filesplice(struct file *in, struct file *out, int n)
+{
+  if(in->readable == 0 || out->writable == 0 || n < 0)
+    return -1;
+  if(in->type == FD_INODE && (out->type == FD_PIPE || out->type == FD_DEVICE))
+    return splicefrom(in, out, n);
+  if(in->type == FD_PIPE && out->type == FD_INODE)
+    return spliceto(in, out, n);
+  return -1;
+}
@@ -1,12 +1,14 @@
 struct file {
-  enum { FD_NONE, FD_PIPE, FD_INODE, FD_DEVICE } type;
+  enum { FD_NONE, FD_PIPE, FD_INODE, FD_DEVICE, FD_EPOLL } type;
   int ref; // reference count
   char readable;
   char writable;
+  char nonblock;     // O_NONBLOCK
   struct pipe *pipe; // FD_PIPE  򿪵ǹָܵܵ
   struct inode *ip;  // FD_INODE and FD_DEVICE ָڴеinode
   uint off;          // FD_INODE  ¼ǰĶдλãͨΪļα
   short major;       // FD_DEVICE
+  struct epoll *ep;  // FD_EPOLL
 };
 
 #define major(dev)  ((dev) >> 16 & 0xFFFF)
@@ -28,14 +30,18 @@ struct inode {
   short nlink;     // ʾָdinodeӲӵ
   uint size;
   uint addrs[NDIRECT+1];  // ǰ12ֱӿţָ򹹳ļǰ12顣һǼӿţָһĿ飬ڴ洢Ŀţ256
+  uint bgoal;         // next-fit allocation goal (not on disk)
 };
 
 // map major device number to device functions.
 struct devsw {
   int (*read)(int, uint64, int);
   int (*write)(int, uint64, int);
+  int (*poll)(void**);  // optional; see filepoll()
+  struct epitem **watch;  // epoll items watching the device, if it notifies
 };
 
 extern struct devsw devsw[];  // devsw¼ÿ豸ŶӦĶд
 
 #define CONSOLE 1
+#define STATS   2
@@ -26,6 +26,8 @@
 // only one device
 struct superblock sb; 
 
+static void bsuminit(int);
+
 // Read the super block.
 static void
 readsb(int dev, struct superblock *sb)  // 볬
@@ -44,6 +46,7 @@ fsinit(int dev) {
   if(sb.magic != FSMAGIC)
     panic("invalid file system");
   initlog(dev, &sb);
+  bsuminit(dev);
 }
 
 // Zero a block.
@@ -61,30 +64,107 @@ bzero(int dev, int bno)
 
 // Blocks.
 
-// Allocate a zeroed disk block.
-// һδʹõ̿飬̿
-static uint
-balloc(uint dev)  
+// In-memory summary of the free bitmap: the number of free bits in
+// each bitmap block, so allocation can skip full bitmap blocks
+// without reading them, and a next-fit cursor used when the caller
+// has no better goal.
+#define NBITMAP (FSSIZE/BPB + 1)
+
+struct {
+  struct spinlock lock;
+  int nfree[NBITMAP];
+  uint cursor;
+} bsum;
+
+// Count the free bits of every bitmap block.
+// Called once the log has been recovered.
+static void
+bsuminit(int dev)
 {
-  int b, bi, m;
   struct buf *bp;
+  int i, bi;
+
+  if((sb.size + BPB - 1) / BPB > NBITMAP)
+    panic("bsuminit: bitmap too big");
+  initlock(&bsum.lock, "bsum");
+  for(i = 0; i * BPB < sb.size; i++){
+    bp = bread(dev, sb.bmapstart + i);
+    bsum.nfree[i] = 0;
+    for(bi = 0; bi < BPB && i * BPB + bi < sb.size; bi++){
+      if((bp->data[bi/8] & (1 << (bi % 8))) == 0)
+        bsum.nfree[i]++;
+    }
+    brelse(bp);
+  }
+  bsum.cursor = 0;
+}
+
+// Mark up to n free blocks in use, searching forward from goal
+// (or from the next-fit cursor if goal is 0) and wrapping around.
+// Block numbers go to out[]; the blocks are not zeroed.
+// Returns the number of blocks allocated.
+static int
+bgrab(uint dev, uint goal, uint *out, int n)
+{
+  int i, nb, got, taken, bi, lo, hi;
+  uint base, start;
+  struct buf *bp;
+
+  acquire(&bsum.lock);
+  if(goal == 0 || goal >= sb.size)
+    goal = bsum.cursor;
+  release(&bsum.lock);
+
+  nb = (sb.size + BPB - 1) / BPB;
+  start = goal / BPB;
+  got = 0;
+  // Visit bitmap blocks start, start+1, ..., start again for
+  // the bits before goal.
+  for(i = 0; i <= nb && got < n; i++){
+    base = ((start + i) % nb) * BPB;
+    lo = (i == 0) ? goal % BPB : 0;
+    hi = (i == nb) ? goal % BPB : BPB;
+    acquire(&bsum.lock);
+    taken = bsum.nfree[base / BPB];
+    release(&bsum.lock);
+    if(taken == 0 || lo >= hi)
+      continue;
 
-  bp = 0;
-  for(b = 0; b < sb.size; b += BPB){  // е̿Ӧbitmapλ
-    bp = bread(dev, BBLOCK(b, sb));   //ȡBPB̿bitmap
-    for(bi = 0; bi < BPB && b + bi < sb.size; bi++){
-      m = 1 << (bi % 8);   // biӦһֽеĵڼbit
-      if((bp->data[bi/8] & m) == 0){  // Is block free?  bi/8ǶӦǰbitmapĵڼֽ
-        bp->data[bi/8] |= m;  // Mark block in use. ѸÿӦbitmapλΪ1
-        log_write(bp);
-        brelse(bp);
-        bzero(dev, b + bi);  //ҵb+bi̿
-        return b + bi;
+    bp = bread(dev, BBLOCK(base, sb));
+    taken = 0;
+    for(bi = lo; bi < hi && base + bi < sb.size && got < n; bi++){
+      if(bp->data[bi/8] == 0xff && bi % 8 == 0){
+        bi += 7;    // whole byte in use
+        continue;
+      }
+      if((bp->data[bi/8] & (1 << (bi % 8))) == 0){
+        bp->data[bi/8] |= 1 << (bi % 8);
+        out[got++] = base + bi;
+        taken++;
       }
     }
+    if(taken){
+      log_write(bp);
+      acquire(&bsum.lock);
+      bsum.nfree[base / BPB] -= taken;
+      bsum.cursor = out[got-1] + 1;
+      release(&bsum.lock);
+    }
     brelse(bp);
   }
-  panic("balloc: out of blocks");
+  return got;
+}
+
+// Allocate a zeroed disk block, preferably at or after goal.
+static uint
+balloc(uint dev, uint goal)
+{
+  uint b;
+
+  if(bgrab(dev, goal, &b, 1) == 0)
+    panic("balloc: out of blocks");
+  bzero(dev, b);
+  return b;
 }
 
 // Free a disk block.
@@ -103,6 +183,10 @@ bfree(int dev, uint b)
   bp->data[bi/8] &= ~m;
   log_write(bp);
   brelse(bp);
+
+  acquire(&bsum.lock);
+  bsum.nfree[b / BPB]++;
+  release(&bsum.lock);
 }
 
 // Inodes.
@@ -315,6 +399,7 @@ ilock(struct inode *ip)
     ip->size = dip->size;
     memmove(ip->addrs, dip->addrs, sizeof(ip->addrs));
     brelse(bp);
+    ip->bgoal = 0;
     ip->valid = 1;
     if(ip->type == 0)
       panic("ilock: no type");
@@ -384,18 +469,29 @@ iunlockput(struct inode *ip)
 // are listed in ip->addrs[].  The next NINDIRECT blocks are
 // listed in block ip->addrs[NDIRECT].
 
-// Return the disk block address of the nth block in inode ip.
-// If there is no such block, bmap allocates one.
-// inode͸߼bnҵӦĴ̿šûжӦ̿飬ballocһ̿
+// Block for ip's next allocation: fresh if the caller supplied one,
+// otherwise a zeroed block following ip's previous allocation.
 static uint
-bmap(struct inode *ip, uint bn)
+inewblock(struct inode *ip, uint fresh)
+{
+  uint b;
+
+  b = fresh ? fresh : balloc(ip->dev, ip->bgoal);
+  ip->bgoal = b + 1;
+  return b;
+}
+
+// Like bmap, but if the nth block is missing, map fresh (an
+// already allocated, unzeroed block) when it is nonzero.
+static uint
+bmapfresh(struct inode *ip, uint bn, uint fresh)
 {
   uint addr, *a;
   struct buf *bp;
 
   if(bn < NDIRECT){
     if((addr = ip->addrs[bn]) == 0)
-      ip->addrs[bn] = addr = balloc(ip->dev);
+      ip->addrs[bn] = addr = inewblock(ip, fresh);
     return addr;
   }
   bn -= NDIRECT;
@@ -403,11 +499,11 @@ bmap(struct inode *ip, uint bn)
   if(bn < NINDIRECT){
     // Load indirect block, allocating if necessary.
     if((addr = ip->addrs[NDIRECT]) == 0)
-      ip->addrs[NDIRECT] = addr = balloc(ip->dev);
+      ip->addrs[NDIRECT] = addr = inewblock(ip, 0);
     bp = bread(ip->dev, addr);
     a = (uint*)bp->data;
     if((addr = a[bn]) == 0){
-      a[bn] = addr = balloc(ip->dev);
+      a[bn] = addr = inewblock(ip, fresh);
       log_write(bp);
     }
     brelse(bp);
@@ -417,6 +513,15 @@ bmap(struct inode *ip, uint bn)
   panic("bmap: out of range");
 }
 
+// Return the disk block address of the nth block in inode ip.
+// If there is no such block, bmap allocates one.
+// inode͸߼bnҵӦĴ̿šûжӦ̿飬ballocһ̿
+static uint
+bmap(struct inode *ip, uint bn)
+{
+  return bmapfresh(ip, bn, 0);
+}
+
 // Truncate inode (discard contents).
 // Caller must hold ip->lock.
 // inodeеݣڴûжʱŻitrunc
@@ -463,6 +568,16 @@ stati(struct inode *ip, struct stat *st)
   st->size = ip->size;
 }
 
+// Return a locked buf holding the block of ip that contains
+// byte off, allocating the block if there is none yet (which
+// must happen inside a transaction). Caller must hold ip->lock.
+// Lets splice move data to and from the buffer cache directly.
+struct buf*
+ibread(struct inode *ip, uint off)
+{
+  return bread(ip->dev, bmap(ip, off/BSIZE));
+}
+
 // Read data from inode.
 // Caller must hold ip->lock.
 // If user_dst==1, then dst is a user virtual address;
@@ -499,7 +614,8 @@ readi(struct inode *ip, int user_dst, uint64 dst, uint off, uint n)
 int
 writei(struct inode *ip, int user_src, uint64 src, uint off, uint n)
 {
-  uint tot, m;
+  uint tot, m, addr, fresh[MAXOPBLOCKS];
+  int i, nfresh;
   struct buf *bp;
 
   if(off > ip->size || off + n < off)
@@ -507,8 +623,20 @@ writei(struct inode *ip, int user_src, uint64 src, uint off, uint n)
   if(off + n > MAXFILE*BSIZE)
     return -1;
 
-  for(tot=0; tot<n; tot+=m, off+=m, src+=m){
-    bp = bread(ip->dev, bmap(ip, off/BSIZE));
+  // Appending whole blocks: allocate them in one bitmap pass and
+  // skip zeroing and reading them, since every byte gets written.
+  nfresh = 0;
+  if(off == ip->size && off % BSIZE == 0 && n >= BSIZE)
+    nfresh = bgrab(ip->dev, ip->bgoal, fresh, min(n / BSIZE, MAXOPBLOCKS));
+
+  for(i=0, tot=0; tot<n; tot+=m, off+=m, src+=m){
+    if(i < nfresh && n - tot >= BSIZE &&
+       (addr = bmapfresh(ip, off/BSIZE, fresh[i])) == fresh[i]){
+      i++;
+      bp = bgetblk(ip->dev, addr);
+    } else {
+      bp = bread(ip->dev, bmap(ip, off/BSIZE));
+    }
     m = min(n - tot, BSIZE - off%BSIZE);  // ÿдֽ
     if(either_copyin(bp->data + (off % BSIZE), user_src, src, m) == -1) {
       brelse(bp);
@@ -526,6 +654,8 @@ writei(struct inode *ip, int user_src, uint64 src, uint off, uint n)
     // block to ip->addrs[].
     iupdate(ip);
   }
+  for(; i < nfresh; i++)
+    bfree(ip->dev, fresh[i]);
 
   return n;
 }
@@ -539,6 +669,227 @@ namecmp(const char *s, const char *t)
   return strncmp(s, t, DIRSIZ);
 }
 
+// Hash a directory entry name (FNV-1a over at most DIRSIZ bytes).
+// mkfs/mkfs.c computes the same hash when it builds an index.
+static uint
+dirhash(char *name)
+{
+  uint h;
+  int i;
+
+  h = 2166136261U;
+  for(i = 0; i < DIRSIZ && name[i]; i++){
+    h ^= (uchar)name[i];
+    h *= 16777619U;
+  }
+  return h;
+}
+
+// Read block 0 of dp if it holds a directory index.
+// Returns the locked buffer, or 0 for a linear directory.
+// A linear directory may hold a live dirent whose name happens
+// to match the magic, so the slot's inum must be zero as well.
+static struct buf*
+dxread(struct inode *dp)
+{
+  struct buf *bp;
+  struct dxroot *root;
+
+  if(dp->size < 2*BSIZE)
+    return 0;
+  bp = bread(dp->dev, bmap(dp, 0));
+  root = (struct dxroot*)bp->data;
+  if(root->zero != 0 || root->magic != DXMAGIC){
+    brelse(bp);
+    return 0;
+  }
+  return bp;
+}
+
+// Index of the entry in root covering hash h.
+static int
+dxfind(struct dxroot *root, uint h)
+{
+  int lo, hi, mid;
+
+  lo = 0;
+  hi = root->nent - 1;
+  while(lo < hi){
+    mid = (lo + hi + 1) / 2;
+    if(root->ent[mid].hash <= h)
+      lo = mid;
+    else
+      hi = mid - 1;
+  }
+  return lo;
+}
+
+// Look up name in an indexed directory.
+// Returns -1 if dp has no index, 0 if name is absent,
+// otherwise the entry's inum with *poff set to its offset.
+static int
+dxlookup(struct inode *dp, char *name, uint *poff)
+{
+  struct buf *bp;
+  struct dxroot *root;
+  struct dirent *de;
+  uint lblk;
+  int i, inum;
+
+  if((bp = dxread(dp)) == 0)
+    return -1;
+  root = (struct dxroot*)bp->data;
+  if(namecmp(name, ".") == 0 || namecmp(name, "..") == 0){
+    de = namecmp(name, ".") == 0 ? &root->dot : &root->dotdot;
+    inum = de->inum;
+    if(poff)
+      *poff = (uchar*)de - bp->data;
+    brelse(bp);
+    return inum;
+  }
+  lblk = root->ent[dxfind(root, dirhash(name))].block;
+  brelse(bp);
+
+  bp = bread(dp->dev, bmap(dp, lblk));
+  de = (struct dirent*)bp->data;
+  inum = 0;
+  for(i = 0; i < DPB; i++){
+    if(de[i].inum != 0 && namecmp(name, de[i].name) == 0){
+      inum = de[i].inum;
+      if(poff)
+        *poff = lblk*BSIZE + i*sizeof(struct dirent);
+      break;
+    }
+  }
+  brelse(bp);
+  return inum;
+}
+
+// Store (name, inum) in a free slot of leaf block bp.
+static int
+dxput(struct buf *bp, char *name, uint inum)
+{
+  struct dirent *de;
+  int i;
+
+  de = (struct dirent*)bp->data;
+  for(i = 0; i < DPB; i++){
+    if(de[i].inum == 0){
+      strncpy(de[i].name, name, DIRSIZ);
+      de[i].inum = inum;
+      return 0;
+    }
+  }
+  return -1;
+}
+
+// Add (name, inum) to an indexed directory, splitting the leaf
+// that covers name's hash if it is full.
+// Returns 0 if dp has no index, 1 on success, -1 if the index is full.
+static int
+dxlink(struct inode *dp, char *name, uint inum)
+{
+  struct buf *bp, *lbp, *nbp;
+  struct dxroot *root;
+  struct dirent *de, *nde;
+  uint h, split, hs[DPB], t, nblk;
+  int i, j, k;
+
+  if((bp = dxread(dp)) == 0)
+    return 0;
+  root = (struct dxroot*)bp->data;
+  h = dirhash(name);
+  i = dxfind(root, h);
+  lbp = bread(dp->dev, bmap(dp, root->ent[i].block));
+  if(dxput(lbp, name, inum) == 0){
+    log_write(lbp);
+    brelse(lbp);
+    brelse(bp);
+    return 1;
+  }
+
+  // Leaf is full: pick the median hash as the split point.
+  de = (struct dirent*)lbp->data;
+  for(j = 0; j < DPB; j++){
+    t = dirhash(de[j].name);
+    for(k = j; k > 0 && hs[k-1] > t; k--)
+      hs[k] = hs[k-1];
+    hs[k] = t;
+  }
+  for(k = DPB/2; k < DPB && hs[k] == hs[0]; k++)
+    ;
+  nblk = dp->size / BSIZE;
+  if(k == DPB || root->nent >= NDXENTRY || nblk >= MAXFILE){
+    brelse(lbp);
+    brelse(bp);
+    return -1;
+  }
+  split = hs[k];
+
+  // Move the upper half into a new leaf at the end of the directory.
+  nbp = bread(dp->dev, bmap(dp, nblk));
+  nde = (struct dirent*)nbp->data;
+  for(j = 0, k = 0; j < DPB; j++){
+    if(dirhash(de[j].name) >= split){
+      nde[k++] = de[j];
+      memset(&de[j], 0, sizeof(de[j]));
+    }
+  }
+  dp->size += BSIZE;
+  iupdate(dp);
+
+  memmove(&root->ent[i+2], &root->ent[i+1],
+          (root->nent - i - 1) * sizeof(struct dxentry));
+  memset(&root->ent[i+1], 0, sizeof(struct dxentry));
+  root->ent[i+1].hash = split;
+  root->ent[i+1].block = nblk;
+  root->nent++;
+
+  if(dxput(h >= split ? nbp : lbp, name, inum) < 0)
+    panic("dxlink");
+  log_write(nbp);
+  log_write(lbp);
+  log_write(bp);
+  brelse(nbp);
+  brelse(lbp);
+  brelse(bp);
+  return 1;
+}
+
+// Convert a full one-block linear directory into an indexed one:
+// block 0 becomes the index root and its entries move to block 1.
+// Returns 0 if dp does not start with "." and "..".
+static int
+dxconvert(struct inode *dp)
+{
+  struct buf *bp, *lbp;
+  struct dxroot *root;
+
+  bp = bread(dp->dev, bmap(dp, 0));
+  root = (struct dxroot*)bp->data;
+  if(namecmp(root->dot.name, ".") != 0 || namecmp(root->dotdot.name, "..") != 0){
+    brelse(bp);
+    return 0;
+  }
+  lbp = bread(dp->dev, bmap(dp, 1));
+  memmove(lbp->data, bp->data, BSIZE);
+  memset(lbp->data, 0, 2*sizeof(struct dirent));
+  log_write(lbp);
+  brelse(lbp);
+
+  memset(&root->zero, 0, BSIZE - 2*sizeof(struct dirent));
+  root->magic = DXMAGIC;
+  root->nent = 1;
+  root->ent[0].hash = 0;
+  root->ent[0].block = 1;
+  log_write(bp);
+  brelse(bp);
+
+  dp->size = 2*BSIZE;
+  iupdate(dp);
+  return 1;
+}
+
 // Look for a directory entry in a directory.
 // If found, set *poff to byte offset of entry.
 // dpĿ¼вnameӦinodeֱֻܲһĿ¼poffnameĿ¼dpеƫ
@@ -547,10 +898,14 @@ dirlookup(struct inode *dp, char *name, uint *poff)
 {
   uint off, inum;
   struct dirent de;
+  int r;
 
   if(dp->type != T_DIR)
     panic("dirlookup not DIR");
 
+  if((r = dxlookup(dp, name, poff)) >= 0)
+    return r ? iget(dp->dev, r) : 0;
+
   for(off = 0; off < dp->size; off += sizeof(de)){  // ȡinode dpӦ̿еÿһĿ¼
     if(readi(dp, 0, (uint64)&de, off, sizeof(de)) != sizeof(de))
       panic("dirlookup read");
@@ -573,7 +928,7 @@ dirlookup(struct inode *dp, char *name, uint *poff)
 int
 dirlink(struct inode *dp, char *name, uint inum)
 {
-  int off;
+  int off, r;
   struct dirent de;
   struct inode *ip;
 
@@ -583,6 +938,9 @@ dirlink(struct inode *dp, char *name, uint inum)
     return -1;
   }
 
+  if((r = dxlink(dp, name, inum)) != 0)
+    return r < 0 ? -1 : 0;
+
   // Look for an empty dirent.
   for(off = 0; off < dp->size; off += sizeof(de)){   // һյĿ¼
     if(readi(dp, 0, (uint64)&de, off, sizeof(de)) != sizeof(de))
@@ -591,6 +949,14 @@ dirlink(struct inode *dp, char *name, uint inum)
       break;
   }
 
+  // A full one-block directory grows an index instead of a second
+  // linear block.
+  if(off == BSIZE && dp->size == BSIZE && dxconvert(dp)){
+    if(dxlink(dp, name, inum) < 0)
+      panic("dirlink: dxlink");
+    return 0;
+  }
+
   strncpy(de.name, name, DIRSIZ);
   de.inum = inum;
   if(writei(dp, 0, (uint64)&de, off, sizeof(de)) != sizeof(de)) // ŪõĿ¼дصdpoffƫ
@@ -653,7 +1019,7 @@ namex(char *path, int nameiparent, char *name)
   if(*path == '/')
     ip = iget(ROOTDEV, ROOTINO);
   else
-    ip = idup(myproc()->cwd);
+    ip = cwdup(myproc());
 
   while((path = skipelem(path, name)) != 0){  // д˸vs֤һ£"/a/b"ĵַҲȷʵwhileѭΣڶskipelempath='\0',name='b'
     // pathһchar**path=='\0'path!=0
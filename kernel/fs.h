@@ -63,3 +63,36 @@ struct dirent {
   char name[DIRSIZ];
 };
 
+// Directory entries per block.
+#define DPB           (BSIZE / sizeof(struct dirent))
+
+// Hashed directory index (htree-style, one level).
+// An indexed directory keeps "." and ".." at the start of block 0,
+// followed by a header and an array of (hash, block) entries sorted
+// by hash; entry i covers names whose hash lies in
+// [ent[i].hash, ent[i+1].hash) and points to a leaf block holding
+// ordinary dirents.  Every 16-byte slot after ".." begins with a
+// zero inum, so code that scans a directory linearly (ls, isdirempty,
+// older kernels) sees only empty entries in block 0.
+#define DXMAGIC 0x78644978
+
+struct dxentry {
+  ushort zero;          // Always 0 (the inum of a dirent slot)
+  ushort pad;
+  uint hash;            // Lowest name hash stored in block
+  uint block;           // Leaf block number within the directory
+  uint pad1;
+};
+
+#define NDXENTRY ((BSIZE - 3*sizeof(struct dirent)) / sizeof(struct dxentry))
+
+struct dxroot {
+  struct dirent dot;
+  struct dirent dotdot;
+  ushort zero;          // Always 0 (the inum of a dirent slot)
+  ushort nent;          // Number of valid ent[]
+  uint magic;           // Must be DXMAGIC
+  uint pad[2];
+  struct dxentry ent[NDXENTRY];
+};
+
@@ -0,0 +1,114 @@
+//
+// futexes: sleeping on a word of user memory.
+// futex_wait(addr, val) sleeps only if the word at addr still
+// holds val, so a user-level lock can check a word and then
+// block without missing a futex_wake(addr, n) in between.
+// Waiters are keyed by (page table, user address), so threads
+// sharing a page table meet on the same key, and are kept in
+// a small hash table of wait queues.
+//
+
+#include "types.h"
+#include "riscv.h"
+#include "defs.h"
+#include "param.h"
+#include "spinlock.h"
+#include "proc.h"
+
+#define NFUTEXHASH 16
+
+// one sleeping futex_wait(), on its kernel stack.
+struct futexq {
+  pagetable_t pagetable;
+  uint64 addr;
+  int woken;
+  struct futexq *next;
+};
+
+struct {
+  struct spinlock lock;
+  struct futexq *head;
+} futexhash[NFUTEXHASH];
+
+void
+futexinit(void)
+{
+  for(int i = 0; i < NFUTEXHASH; i++)
+    initlock(&futexhash[i].lock, "futex");
+}
+
+static int
+futexkey(pagetable_t pagetable, uint64 addr)
+{
+  return ((uint64)pagetable / PGSIZE + addr / sizeof(int)) % NFUTEXHASH;
+}
+
+// futex_wait(addr, val): if the int at addr is val, sleep until
+// a futex_wake() on addr. Returns 0 once woken, or -1 if the
+// word didn't hold val (or the caller was killed).
+uint64
+sys_futex_wait(void)
+{
+  struct proc *p = myproc();
+  struct futexq q, **pp;
+  uint64 addr;
+  int val, cur, h;
+
+  if(argaddr(0, &addr) < 0 || argint(1, &val) < 0 || addr % sizeof(int) != 0)
+    return -1;
+  h = futexkey(p->pagetable, addr);
+
+  // the bucket lock is held from the check to the sleep, and
+  // futex_wake() takes it too, so no wakeup can slip between.
+  acquire(&futexhash[h].lock);
+  if(copyin(p->pagetable, (char*)&cur, addr, sizeof(cur)) < 0 || cur != val){
+    release(&futexhash[h].lock);
+    return -1;
+  }
+  q.pagetable = p->pagetable;
+  q.addr = addr;
+  q.woken = 0;
+  q.next = 0;
+  for(pp = &futexhash[h].head; *pp; pp = &(*pp)->next)
+    ;
+  *pp = &q;  // at the tail, so wakeups go first-come first-served
+  while(!q.woken && !p->killed)
+    sleep(&q, &futexhash[h].lock);
+  if(!q.woken){
+    for(pp = &futexhash[h].head; *pp != &q; pp = &(*pp)->next)
+      ;
+    *pp = q.next;
+  }
+  release(&futexhash[h].lock);
+  return q.woken ? 0 : -1;
+}
+
+// futex_wake(addr, n): wake up to n threads waiting on addr.
+// Returns how many were woken.
+uint64
+sys_futex_wake(void)
+{
+  struct proc *p = myproc();
+  struct futexq *q, **pp;
+  uint64 addr;
+  int n, woken, h;
+
+  if(argaddr(0, &addr) < 0 || argint(1, &n) < 0)
+    return -1;
+  h = futexkey(p->pagetable, addr);
+
+  woken = 0;
+  acquire(&futexhash[h].lock);
+  for(pp = &futexhash[h].head; woken < n && (q = *pp) != 0; ){
+    if(q->pagetable == p->pagetable && q->addr == addr){
+      *pp = q->next;
+      q->woken = 1;
+      wakeup(q);
+      woken++;
+    } else {
+      pp = &q->next;
+    }
+  }
+  release(&futexhash[h].lock);
+  return woken;
+}
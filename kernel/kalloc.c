@@ -14,6 +14,7 @@
 #include "spinlock.h"
 #include "riscv.h"
 #include "defs.h"
+#include "stats.h"
 
 void freerange(void *pa_start, void *pa_end);
 
@@ -27,6 +28,8 @@ struct run {
 struct {
   struct spinlock lock;
   struct run *freelist;
+  uint nfree;   // pages on freelist
+  uint npage;   // pages handed to kinit()
 } kmem;  //ܵlockı
 
 void
@@ -34,6 +37,7 @@ kinit()
 {
   initlock(&kmem.lock, "kmem");
   freerange(end, (void*)PHYSTOP);
+  kmem.npage = kmem.nfree;
 }
 
 void
@@ -65,6 +69,7 @@ kfree(void *pa)
   acquire(&kmem.lock);
   r->next = kmem.freelist;
   kmem.freelist = r;
+  kmem.nfree++;
   release(&kmem.lock);
 }
 
@@ -78,11 +83,22 @@ kalloc(void)
 
   acquire(&kmem.lock);
   r = kmem.freelist;
-  if(r)
+  if(r){
     kmem.freelist = r->next;
+    kmem.nfree--;
+  }
   release(&kmem.lock);
 
   if(r)
     memset((char*)r, 5, PGSIZE); // fill with junk
   return (void*)r;
 }
+
+void
+kmemstats(struct kstats *ks)
+{
+  acquire(&kmem.lock);
+  ks->freepages = kmem.nfree;
+  ks->totalpages = kmem.npage;
+  release(&kmem.lock);
+}
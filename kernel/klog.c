@@ -0,0 +1,133 @@
+//
+// Kernel log.
+// Each CPU appends printf() output to a ring of records of its
+// own, with interrupts off and without locks, so printing never
+// waits for another CPU or for the UART. The UART sends the text
+// from its interrupt handler (see uartstart()), taking records
+// from all rings in time order. A ring holding nothing but
+// unsent records is full, and only then does its CPU wait,
+// driving the UART by hand. Sent records stay in the ring until
+// overwritten, for dmesg().
+//
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "defs.h"
+#include "klog.h"
+
+struct klogrec {
+  uint64 time;   // time CSR
+  int len;
+  char text[KLOGTEXT];
+};
+
+struct {
+  struct klogrec rec[NKLOG];
+  uint head;     // next record to write; only this CPU writes it
+  uint sent;     // next record to send to the UART (uart_tx_lock)
+  int sentoff;   // bytes of it already sent
+} klog[NCPU];
+
+// Append n bytes of s, at most KLOGTEXT, as one record.
+void
+klogwrite(char *s, int n)
+{
+  struct klogrec *r;
+  int c;
+
+  for(;;){
+    push_off();
+    c = cpuid();
+    if(klog[c].head - klog[c].sent < NKLOG)
+      break;
+    pop_off();
+    uartpoll();
+  }
+  r = &klog[c].rec[klog[c].head % NKLOG];
+  r->time = r_time();
+  r->len = n;
+  memmove(r->text, s, n);
+  __sync_synchronize();
+  klog[c].head++;
+  pop_off();
+}
+
+// Copy up to n bytes of text not yet sent to the UART into
+// buf, oldest first; returns how many.
+// Caller must hold uart_tx_lock, or be panicking.
+int
+klogtake(char *buf, int n)
+{
+  struct klogrec *r;
+  int i, best, m, got;
+
+  for(got = 0; got < n; got += m){
+    best = -1;
+    for(i = 0; i < NCPU; i++)
+      if(klog[i].sent != klog[i].head &&
+         (best < 0 || klog[i].rec[klog[i].sent % NKLOG].time <
+                      klog[best].rec[klog[best].sent % NKLOG].time))
+        best = i;
+    if(best < 0)
+      break;
+    __sync_synchronize();
+    r = &klog[best].rec[klog[best].sent % NKLOG];
+    m = r->len - klog[best].sentoff;
+    if(m > n - got)
+      m = n - got;
+    memmove(buf + got, r->text + klog[best].sentoff, m);
+    klog[best].sentoff += m;
+    if(klog[best].sentoff == r->len){
+      klog[best].sentoff = 0;
+      klog[best].sent++;
+    }
+  }
+  return got;
+}
+
+// dmesg(buf, n): copy up to n bytes of the log, oldest first,
+// to buf; returns how many. Records being overwritten as they
+// are read are left out.
+uint64
+sys_dmesg(void)
+{
+  struct klogrec r;
+  uint cur[NCPU];
+  uint64 buf;
+  int n, i, best, got, m;
+
+  if(argaddr(0, &buf) < 0 || argint(1, &n) < 0 || n < 0)
+    return -1;
+  for(i = 0; i < NCPU; i++)
+    cur[i] = klog[i].head < NKLOG ? 0 : klog[i].head - NKLOG + 1;
+
+  for(got = 0; got < n; got += m){
+    // the oldest record not yet copied, if still there.
+    best = -1;
+    for(i = 0; i < NCPU; i++){
+      if(klog[i].head - cur[i] >= NKLOG)
+        cur[i] = klog[i].head - NKLOG + 1;
+      if(cur[i] != klog[i].head &&
+         (best < 0 || klog[i].rec[cur[i] % NKLOG].time <
+                      klog[best].rec[cur[best] % NKLOG].time))
+        best = i;
+    }
+    if(best < 0)
+      break;
+    __sync_synchronize();
+    r = klog[best].rec[cur[best] % NKLOG];
+    __sync_synchronize();
+    m = 0;
+    if(klog[best].head - cur[best] >= NKLOG)
+      continue;  // overwritten while we copied it
+    cur[best]++;
+    m = r.len < n - got ? r.len : n - got;
+    if(copyout(myproc()->pagetable, buf + got, r.text, m) < 0)
+      return -1;
+  }
+  return got;
+}
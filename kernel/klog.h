@@ -0,0 +1,9 @@
+// Kernel log (dmesg()). printf() appends each piece of its
+// output as a record to the ring of the CPU it runs on; the
+// UART and dmesg() read the rings merged in time order.
+
+#define NKLOG     128  // records per CPU
+#define KLOGTEXT  112  // bytes of text in a record
+
+// most bytes dmesg() can return.
+#define KLOGMAX   (NCPU*NKLOG*KLOGTEXT)
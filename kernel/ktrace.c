@@ -0,0 +1,147 @@
+//
+// Kernel tracepoints.
+// KTRACE() at an interesting site costs one test of ktmask
+// when its event type is off. When on, ktrec() stamps the event
+// with the time CSR and appends it to this CPU's ring. Only
+// this CPU writes its ring, with interrupts off, so no lock is
+// taken: the event goes in first and head moves after it, and
+// the oldest events are overwritten once the ring is full.
+// ktrace() reads the rings, checking that the writer has not
+// lapped the reader meanwhile.
+//
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "defs.h"
+#include "ktrace.h"
+
+#define NKTEVENT 1024  // per CPU
+
+struct ktring {
+  struct ktevent ev[NKTEVENT];
+  uint64 head;  // events ever written; only this CPU writes it
+  uint64 tail;  // next to read; under ktlock
+} ktring[NCPU];
+
+volatile int ktmask;
+struct spinlock ktlock;
+static uint64 lost;  // overwritten unread; under ktlock
+
+void
+ktraceinit(void)
+{
+  initlock(&ktlock, "ktrace");
+}
+
+void
+ktrec(int type, uint64 a, uint64 b)
+{
+  struct ktring *r;
+  struct ktevent *e;
+  struct proc *p;
+  int id;
+
+  push_off();
+  id = cpuid();
+  r = &ktring[id];
+  e = &r->ev[r->head % NKTEVENT];
+  e->time = r_time();
+  e->type = type;
+  e->cpu = id;
+  e->pid = (p = mycpu()->proc) != 0 ? p->pid : 0;
+  e->a = a;
+  e->b = b;
+  __sync_synchronize();
+  r->head++;
+  pop_off();
+}
+
+// Skip r's reader past events the writer has overwritten.
+// Returns r->head. Caller holds ktlock.
+static uint64
+ktlap(struct ktring *r)
+{
+  uint64 head = r->head;
+
+  __sync_synchronize();
+  if(head - r->tail > NKTEVENT){
+    lost += head - NKTEVENT - r->tail;
+    r->tail = head - NKTEVENT;
+  }
+  return head;
+}
+
+// Take the oldest unread event of any CPU into *e.
+// Returns 0 if there is none. Caller holds ktlock.
+static int
+ktnext(struct ktevent *e)
+{
+  struct ktring *r, *best;
+  int i;
+
+  for(;;){
+    best = 0;
+    for(i = 0; i < NCPU; i++){
+      r = &ktring[i];
+      if(r->tail != ktlap(r) &&
+         (best == 0 || r->ev[r->tail % NKTEVENT].time < best->ev[best->tail % NKTEVENT].time))
+        best = r;
+    }
+    if(best == 0)
+      return 0;
+    *e = best->ev[best->tail % NKTEVENT];
+    __sync_synchronize();
+    // the writer starts overwriting this slot once head
+    // reaches tail + NKTEVENT.
+    if(best->head - best->tail < NKTEVENT){
+      best->tail++;
+      return 1;
+    }
+  }
+}
+
+// ktrace(cmd, arg, buf): see ktrace.h.
+uint64
+sys_ktrace(void)
+{
+  struct proc *p = myproc();
+  struct ktevent e;
+  uint64 buf;
+  int cmd, arg, n, i;
+
+  if(argint(0, &cmd) < 0 || argint(1, &arg) < 0 || argaddr(2, &buf) < 0)
+    return -1;
+  switch(cmd){
+  case KT_START:
+    ktmask = 0;
+    acquire(&ktlock);
+    for(i = 0; i < NCPU; i++)
+      ktring[i].tail = ktring[i].head;
+    lost = 0;
+    release(&ktlock);
+    ktmask = arg;
+    return 0;
+  case KT_STOP:
+    ktmask = 0;
+    acquire(&ktlock);
+    for(i = 0; i < NCPU; i++)
+      ktlap(&ktring[i]);
+    n = lost;
+    release(&ktlock);
+    return n;
+  case KT_READ:
+    for(n = 0; n < arg; n++){
+      acquire(&ktlock);
+      i = ktnext(&e);
+      release(&ktlock);
+      if(i == 0 || copyout(p->pagetable, buf + n*sizeof(e), (char*)&e, sizeof(e)) < 0)
+        break;
+    }
+    return n;
+  }
+  return -1;
+}
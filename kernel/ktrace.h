@@ -0,0 +1,33 @@
+// Kernel tracepoints (ktrace()). Each CPU records the enabled
+// events into a ring of its own, without locks; ktrace() reads
+// them back merged in time order.
+
+// event types; ktrace(KT_START, mask) enables 1<<type.
+#define KT_SYSCALL   0   // a: syscall number, b: first argument
+#define KT_SYSRET    1   // a: syscall number, b: return value
+#define KT_SWITCH    2   // scheduler runs pid; a: MLFQ level
+#define KT_BREAD     3   // a: block, b: 1 if it was cached
+#define KT_BWRITE    4   // a: block
+#define KT_COMMIT    5   // log commit begins; a: blocks to log
+#define KT_COMMITTED 6   // log commit done; a: blocks in the log
+#define KT_DISKSUB   7   // disk request; a: first block, b: nblocks*2 + write
+#define KT_DISKDONE  8   // disk request done; a: first block
+#define KT_FAULT     9   // user fault; a: scause, b: stval
+#define KT_NTYPE     10
+
+// ktrace(cmd, arg, buf) commands.
+#define KT_START  1  // arg: mask of event types
+#define KT_STOP   2  // returns how many events were overwritten unread
+#define KT_READ   3  // copy up to arg events to buf; returns how many
+
+struct ktevent {
+  uint64 time;  // time CSR
+  ushort type;
+  ushort cpu;
+  int pid;      // process running on the CPU, or 0
+  uint64 a, b;
+};
+
+// in the kernel: record an event, if its type is enabled.
+#define KTRACE(type, x, y) \
+  do { if(ktmask & (1 << (type))) ktrec((type), (uint64)(x), (uint64)(y)); } while(0)
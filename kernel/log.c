@@ -2,10 +2,13 @@
 #include "riscv.h"
 #include "defs.h"
 #include "param.h"
+#include "memlayout.h"
 #include "spinlock.h"
 #include "sleeplock.h"
 #include "fs.h"
 #include "buf.h"
+#include "ktrace.h"
+#include "stats.h"
 
 // Simple logging that allows concurrent FS system calls.
 //
@@ -29,13 +32,32 @@
 //   block C
 //   ...
 // Log appends are synchronous.
+//
+// The header records a checksum of every log block, so a commit
+// writes its log blocks and the header as a single batch of disk
+// requests instead of waiting for the blocks before writing the
+// header. If a crash tears the batch, recover_from_log() finds a
+// checksum mismatch and discards that last transaction. The header
+// fits in one 512-byte sector, which the disk writes atomically.
+//
+// Installing committed blocks at their home locations is deferred:
+// a commit appends the transaction after the blocks of earlier,
+// still-uninstalled commits and leaves the cached buffers dirty.
+// Log space is reclaimed by checkpoint(), which writes each dirty
+// home block once, in block-number order, and then empties the log.
+// It runs when the log is nearly full and periodically from the
+// flusher kernel process, so a hot block (bitmap, inode block)
+// changed by many transactions is written home only once.
 
 // Contents of the header block, used for both the on-disk header block
 // and to keep track in memory of logged block# before commit.
 // ϵlog header
 struct logheader {
   int n;  // ¼Ҫ޸ĵļ
+  int nprev;           // slots committed before the latest commit
+  uint hsum;           // checksum of this header (excluding hsum)
   int block[LOGSIZE];  // ¼Ҫ޸ĵ̿̿
+  uint sum[LOGSIZE];   // checksum of each log block
 };
 
 struct log {
@@ -44,6 +66,9 @@ struct log {
   int size;   // log̿
   int outstanding; // ¼ǰbegin_opûеend_opһoutstanding0Ҳͱʾύ
   int committing;  // һ־Ƿڽύ
+  int committed;   // lh.block[0..committed) are committed but not installed
+  int ncommit;     // number of group commits so far
+  uint64 nlogged;  // blocks written to the log so far
   int dev;
   struct logheader lh;
 };
@@ -51,11 +76,12 @@ struct log log;   // 
 
 static void recover_from_log(void);
 static void commit();
+static void flusher(void);
 
 void
 initlog(int dev, struct superblock *sb)
 {
-  if (sizeof(struct logheader) >= BSIZE)
+  if (sizeof(struct logheader) > 512)
     panic("initlog: too big logheader");
 
   initlock(&log.lock, "log");
@@ -63,9 +89,13 @@ initlog(int dev, struct superblock *sb)
   log.size = sb->nlog;
   log.dev = dev;
   recover_from_log();  // ʼȻָһ־
+  if(kthread(flusher, "flusher") < 0)
+    panic("initlog: flusher");
 }
 
-// Copy committed blocks from log to their home location
+// Copy committed blocks from log to their home location.
+// Only used by recovery; normal commits leave the blocks dirty
+// in the cache for checkpoint().
 // ݴlogתʵʵ̿飬ǻڴеlog header
 static void
 install_trans(void)
@@ -77,45 +107,68 @@ install_trans(void)
     struct buf *dbuf = bread(log.dev, log.lh.block[tail]); // ȡҪд̿飬Ϊlog_writeüԴ̿Ļᱻﻹǻӻȡ
     memmove(dbuf->data, lbuf->data, BSIZE);  // log̿д뵽ӦдĴ̿
     bwrite(dbuf);  // write dst to disk
-    bunpin(dbuf);  // ΪdbufѾд̣ԼһԸûüöӦlog_writeеbpin
-    // һ룬Ϊʲôǰwrite_logڼüϾwrite_logѾѻдlogˡ
-    // ֣д֮ǰüпɻǰ
-    // Ȼ󻺳ͱдش̣ƻlogƵԭԡ
     brelse(lbuf);
     brelse(dbuf);
   }
 }
 
+// Checksum of n bytes (FNV-1a).
+static uint
+logsum(void *p, int n)
+{
+  uchar *s = p;
+  uint h = 2166136261U;
+
+  while(n-- > 0){
+    h ^= *s++;
+    h *= 16777619U;
+  }
+  return h;
+}
+
 // Read the log header from disk into the in-memory log header
 // ȡеlog header洢ڴlogṹ
+// A header with a bad checksum counts as an empty log.
 static void
 read_head(void)
 {
   struct buf *buf = bread(log.dev, log.start);
-  struct logheader *lh = (struct logheader *) (buf->data);
-  int i;
-  log.lh.n = lh->n;
-  for (i = 0; i < log.lh.n; i++) {
-    log.lh.block[i] = lh->block[i];
-  }
+  uint hsum;
+
+  memmove(&log.lh, buf->data, sizeof(log.lh));
   brelse(buf);
+  if (log.lh.n == 0)
+    return;
+  hsum = log.lh.hsum;
+  log.lh.hsum = 0;
+  if (log.lh.n < 0 || log.lh.n > LOGSIZE ||
+      hsum != logsum(&log.lh, sizeof(log.lh))) {
+    printf("log: bad header, ignoring log\n");
+    log.lh.n = 0;
+  }
+}
+
+// Copy the in-memory log header, with a fresh checksum, into buf.
+static void
+fill_head(struct buf *buf)
+{
+  log.lh.hsum = 0;
+  log.lh.hsum = logsum(&log.lh, sizeof(log.lh));
+  memmove(buf->data, &log.lh, sizeof(log.lh));
 }
 
 // Write in-memory log header to disk.
-// This is the true point at which the
-// current transaction commits.
+// Commits write the header together with their log blocks, in
+// write_log(); this is used to empty the log.
 // ڴеlog headerд
 static void
 write_head(void)
 {
   struct buf *buf = bread(log.dev, log.start);
-  struct logheader *hb = (struct logheader *) (buf->data);
-  int i;
-  hb->n = log.lh.n;
-  for (i = 0; i < log.lh.n; i++) {
-    hb->block[i] = log.lh.block[i];
-  }
-  bwrite(buf);  //ύ㣬ֻҪһɣlogͿдʵҪдλ
+
+  log.lh.nprev = 0;
+  fill_head(buf);
+  bwrite(buf);
   brelse(buf);
 }
 
@@ -123,7 +176,24 @@ write_head(void)
 static void
 recover_from_log(void)
 {
+  struct buf *b;
+  int i, ok;
+
   read_head();
+  // Find the first log block whose checksum does not match. If it
+  // belongs to the latest commit, that commit's batch was torn by
+  // the crash, so only the transactions before it are installed.
+  for (i = 0; i < log.lh.n; i++) {
+    b = bread(log.dev, log.start+i+1);
+    ok = (logsum(b->data, BSIZE) == log.lh.sum[i]);
+    brelse(b);
+    if (!ok)
+      break;
+  }
+  if (i < log.lh.n) {
+    printf("log: discarding torn commit\n");
+    log.lh.n = (i >= log.lh.nprev) ? log.lh.nprev : 0;
+  }
   install_trans(); // if committed, copy from log to disk
   log.lh.n = 0;
   write_head(); // clear the log
@@ -180,43 +250,140 @@ end_op(void)
     commit();
     acquire(&log.lock);
     log.committing = 0;
+    log.ncommit++;
     wakeup(&log);
     release(&log.lock);
   }
 }
 
-// Copy modified blocks from cache to log.
-// ޸˵Ĵ̿д뵽logΪxv6޸Ĵݶ޸ĻڵݣbreadȡǻݣҲ޸˵ġ
+// Wait until every transaction that has already ended is
+// committed to the log, and so survives a crash.
+void
+log_force(void)
+{
+  int n;
+
+  acquire(&log.lock);
+  if(log.outstanding > 0){
+    // the last end_op() of this group will commit it.
+    n = log.ncommit;
+    while(log.ncommit == n)
+      sleep(&log, &log.lock);
+  }
+  while(log.committing)
+    sleep(&log, &log.lock);
+  release(&log.lock);
+}
+
+// Commit the current transaction: write its blocks straight from
+// the buffer cache into their log slots, plus the new header with
+// their checksums, as one batch of disk requests.
 static void
 write_log(void)
 {
-  int tail;
+  struct buf *bs[LOGSIZE+1];
+  uint to[LOGSIZE+1];
+  int tail, n;
 
-  for (tail = 0; tail < log.lh.n; tail++) {
-    struct buf *to = bread(log.dev, log.start+tail+1); // log block
-    struct buf *from = bread(log.dev, log.lh.block[tail]); // ȡݣҲ޸˵
-    memmove(to->data, from->data, BSIZE);
-    bwrite(to);  // write the log
-    brelse(from);
-    brelse(to);
+  n = 0;
+  for (tail = log.committed; tail < log.lh.n; tail++) {
+    bs[n] = bread(log.dev, log.lh.block[tail]); // ȡݣҲ޸˵
+    log.lh.sum[tail] = logsum(bs[n]->data, BSIZE);
+    to[n++] = log.start+tail+1;
   }
+  log.lh.nprev = log.committed;
+  bs[n] = bread(log.dev, log.start);
+  fill_head(bs[n]);
+  to[n++] = log.start;
+  bwritev(bs, to, n);   // write the log and the header
+  for (tail = 0; tail < n; tail++)
+    brelse(bs[tail]);
+}
+
+// Write every committed block to its home location, in block-number
+// order and once per block however many transactions logged it,
+// then empty the log. Caller must have set log.committing.
+static void
+checkpoint(void)
+{
+  uint blocks[LOGSIZE];
+  struct buf *bs[LOGSIZE];
+  int i, j, n;
+
+  n = 0;
+  for (i = 0; i < log.committed; i++) {
+    for (j = n; j > 0 && blocks[j-1] > log.lh.block[i]; j--)
+      ;
+    if (j > 0 && blocks[j-1] == log.lh.block[i])
+      continue;
+    memmove(&blocks[j+1], &blocks[j], (n-j)*sizeof(uint));
+    blocks[j] = log.lh.block[i];
+    n++;
+  }
+  for (i = 0; i < n; i++)
+    bs[i] = bread(log.dev, blocks[i]);
+  bwritev(bs, blocks, n);
+  for (i = 0; i < n; i++) {
+    bs[i]->dirty = 0;
+    brelse(bs[i]);
+  }
+  log.lh.n = 0;
+  log.committed = 0;
+  write_head();    // Erase the installed transactions from the log
 }
 
 static void
 commit()
 {
-  if (log.lh.n > 0) {
-    write_log();     // write_logwrite_head˳ܵߵߵ֮ᵼ־ȱʧ
-    write_head();    // Write header to disk -- the real commit
-    install_trans(); // Now install writes to home locations
-    log.lh.n = 0;
-    write_head();    // Erase the transaction from the log
+  if (log.lh.n > log.committed) {
+    KTRACE(KT_COMMIT, log.lh.n - log.committed, 0);
+    log.nlogged += log.lh.n - log.committed;
+    write_log();     // Write log blocks and header -- the real commit
+    log.committed = log.lh.n;
+    KTRACE(KT_COMMITTED, log.committed, 0);
+  }
+  // Make sure the next transaction fits.
+  if (log.committed + MAXOPBLOCKS > log.size - 1)
+    checkpoint();
+}
+
+// Checkpoint the log FLUSHTICKS ticks after something is
+// committed, so committed blocks reach their home locations
+// even when the file system is idle. With nothing committed
+// the flusher sleeps until end_op() wakes it.
+static void
+flusher(void)
+{
+  for(;;){
+    acquire(&log.lock);
+    while(log.committed == 0)
+      sleep(&log, &log.lock);
+    release(&log.lock);
+    sleepuntil(r_time() + FLUSHTICKS*TICKCYCLES);
+
+    acquire(&log.lock);
+    while(log.committing || log.outstanding > 0)
+      sleep(&log, &log.lock);
+    if(log.committed == 0){
+      release(&log.lock);
+      continue;
+    }
+    log.committing = 1;
+    release(&log.lock);
+
+    checkpoint();
+
+    acquire(&log.lock);
+    log.committing = 0;
+    wakeup(&log);
+    release(&log.lock);
   }
 }
 
 // Caller has modified b->data and is done with the buffer.
-// Record the block number and pin in the cache by increasing refcnt.
-// commit()/write_log() will do the disk write.
+// Record the block number and mark the buffer dirty, which keeps
+// it in the cache until checkpoint() writes it home.
+// commit()/write_log() will do the log write.
 //
 // log_write() replaces bwrite(); a typical use is:
 //   bp = bread(...)
@@ -235,17 +402,24 @@ log_write(struct buf *b)
     panic("log_write outside of trans");
 
   acquire(&log.lock);
-  for (i = 0; i < log.lh.n; i++) {
+  // A block already committed gets a new slot: its committed copy
+  // in the log must stay intact until this transaction commits.
+  for (i = log.committed; i < log.lh.n; i++) {
     if (log.lh.block[i] == b->blockno)   // log absorbtion
       break;
   }
   log.lh.block[i] = b->blockno;
-  if (i == log.lh.n) {  // Add new block to log? ҪдĴ̺Ųlog header
-    bpin(b);   // Ѹû̶buffer
-    // ύʱ,install_transҪ־ȡ޸ĺ,临Ƶļϵͳʵʴ̿,
-    // Ϊ˷ֹ,صĻڴ,xv6뱣֤ЩڴСüʱԵֹûͷŻ߻
+  if (i == log.lh.n)  // Add new block to log? ҪдĴ̺Ųlog header
     log.lh.n++;
-  }
+  b->dirty = 1;
   release(&log.lock);
 }
 
+void
+logstats(struct kstats *ks)
+{
+  acquire(&log.lock);
+  ks->ncommit = log.ncommit;
+  ks->nlogged = log.nlogged;
+  release(&log.lock);
+}
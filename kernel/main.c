@@ -12,7 +12,6 @@ void main()
   if (cpuid() == 0)
   {
     consoleinit();
-    printfinit();
     printf("\n");
     printf("xv6 kernel is booting\n");
     printf("\n");
@@ -20,15 +19,24 @@ void main()
     kvminit();          // create kernel page table  ںַַӳ
     kvminithart();      // turn on paging  ںʹõҳĿ¼ַд뵽 SATP Ĵ
     procinit();         // process table  Ϊÿں˽̷ںջӳ䣬ںвûλguard page飬ûռȴΪguard page
-    trapinit();         // trap vectors
+    timerqinit();       // per-CPU timers
     trapinithart();     // install kernel trap vector  ʼʼʱstvecĴΪkernelvec
     plicinit();         // set up interrupt controller
     plicinithart();     // ask PLIC for device interrupts  ǰCPU0ýUART0_IRQVIRTIO0_IRQж
     binit();            // buffer cache
     iinit();            // inode cache
     fileinit();         // file table
+    epollinit();        // epoll
+    futexinit();        // futex wait queues
+    profinit();         // sampling profiler
+    ktraceinit();       // tracepoints
+    statsinit();        // stats device
     virtio_disk_init(); // emulated hard disk
+#ifdef MEMBENCH
+    membench();         // string.c check and benchmark
+#endif
     userinit();         // first user process
+    aioinit();          // async I/O workers
     __sync_synchronize();
     started = 1;
   }
@@ -0,0 +1,176 @@
+//
+// Boot-time check and benchmark of the string.c routines
+// against byte-at-a-time loops like the ones they replaced.
+// Built and run only with "make MEMBENCH=1".
+//
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "fs.h"
+#include "defs.h"
+
+#define REPS 256
+
+static void*
+bytemove(void *dst, const void *src, uint n)
+{
+  const char *s = src;
+  char *d = dst;
+
+  if(s < d && s + n > d){
+    s += n;
+    d += n;
+    while(n-- > 0)
+      *--d = *--s;
+  } else
+    while(n-- > 0)
+      *d++ = *s++;
+  return dst;
+}
+
+static void*
+byteset(void *dst, int c, uint n)
+{
+  char *d = dst;
+
+  while(n-- > 0)
+    *d++ = c;
+  return dst;
+}
+
+static int
+bytecmp(const void *v1, const void *v2, uint n)
+{
+  const uchar *s1 = v1, *s2 = v2;
+
+  for(; n > 0; n--, s1++, s2++)
+    if(*s1 != *s2)
+      return *s1 - *s2;
+  return 0;
+}
+
+static void*
+pagemove(void *dst, const void *src, uint n)
+{
+  copy_page(dst, src);
+  return dst;
+}
+
+static void*
+pageset(void *dst, int c, uint n)
+{
+  zero_page(dst);
+  return dst;
+}
+
+// Compare the word-wide routines with the byte loops
+// at every small alignment and length.
+static void
+check(char *a, char *b, char *c)
+{
+  int so, dof, n, i;
+
+  for(so = 0; so < 16; so++){
+    for(dof = 0; dof < 16; dof++){
+      for(n = 0; n < 200; n += 7){
+        for(i = 0; i < 512; i++)
+          b[i] = c[i] = a[i];
+        memmove(b+dof, b+so, n);
+        bytemove(c+dof, c+so, n);
+        memmove(b+256+dof, a+so, n);
+        bytemove(c+256+dof, a+so, n);
+        if(bytecmp(b, c, 512) != 0)
+          panic("membench: memmove");
+        memset(b+so, dof, n);
+        byteset(c+so, dof, n);
+        if(bytecmp(b, c, 512) != 0)
+          panic("membench: memset");
+        if(n > 0){
+          b[so+n-1]++;
+          if((memcmp(b+so, c+so, n) > 0) != (bytecmp(b+so, c+so, n) > 0) ||
+             memcmp(c+so, c+so, n) != 0)
+            panic("membench: memcmp");
+        }
+      }
+    }
+  }
+}
+
+// MB/s for REPS runs over n bytes in t timer ticks.
+static int
+mbps(uint n, uint64 t)
+{
+  if(t == 0)
+    t = 1;
+  return (uint64)n * REPS * TIMEBASE / t / 1000000;
+}
+
+static uint64
+timemove(void *(*f)(void*, const void*, uint), void *d, const void *s, uint n)
+{
+  uint64 t0 = r_time();
+
+  for(int i = 0; i < REPS; i++)
+    f(d, s, n);
+  return r_time() - t0;
+}
+
+static uint64
+timeset(void *(*f)(void*, int, uint), void *d, uint n)
+{
+  uint64 t0 = r_time();
+
+  for(int i = 0; i < REPS; i++)
+    f(d, 0, n);
+  return r_time() - t0;
+}
+
+static uint64
+timecmp(int (*f)(const void*, const void*, uint), const void *a, const void *b, uint n)
+{
+  uint64 t0 = r_time();
+
+  for(int i = 0; i < REPS; i++)
+    f(a, b, n);
+  return r_time() - t0;
+}
+
+static void
+report(char *what, uint n, uint64 tbyte, uint64 tword)
+{
+  printf("membench: %s %d bytes: %d MB/s byte-wise, %d MB/s now\n",
+         what, n, mbps(n, tbyte), mbps(n, tword));
+}
+
+void
+membench(void)
+{
+  static uint sizes[] = { 64, BSIZE, PGSIZE };
+  char *a, *b, *c;
+  uint n;
+
+  if((a = kalloc()) == 0 || (b = kalloc()) == 0 || (c = kalloc()) == 0)
+    panic("membench: kalloc");
+  for(int i = 0; i < PGSIZE; i++)
+    a[i] = i * 7;
+  check(a, b, c);
+
+  for(int i = 0; i < NELEM(sizes); i++){
+    n = sizes[i];
+    report("memmove", n, timemove(bytemove, b, a, n), timemove(memmove, b, a, n));
+  }
+  n = PGSIZE - 8;
+  report("memmove misaligned", n, timemove(bytemove, b, a+1, n), timemove(memmove, b, a+1, n));
+  report("memmove overlapping", n, timemove(bytemove, b+8, b, n), timemove(memmove, b+8, b, n));
+  report("copy_page", PGSIZE, timemove(bytemove, b, a, PGSIZE), timemove(pagemove, b, a, PGSIZE));
+  report("memset", PGSIZE, timeset(byteset, b, PGSIZE), timeset(memset, b, PGSIZE));
+  report("zero_page", PGSIZE, timeset(byteset, b, PGSIZE), timeset(pageset, b, PGSIZE));
+  memmove(c, a, PGSIZE);
+  report("memcmp", PGSIZE, timecmp(bytecmp, c, a, PGSIZE), timecmp(memcmp, c, a, PGSIZE));
+
+  kfree(a);
+  kfree(b);
+  kfree(c);
+}
@@ -29,6 +29,9 @@
 #define CLINT 0x2000000L
 #define CLINT_MTIMECMP(hartid) (CLINT + 0x4000 + 8*(hartid))
 #define CLINT_MTIME (CLINT + 0xBFF8) // cycles since boot.
+#define TIMEBASE 10000000L // CLINT_MTIME cycles per second in qemu.
+#define TICKCYCLES (TIMEBASE/10) // cycles per clock tick, as uptime() counts.
+#define NSPERCYCLE (1000000000L/TIMEBASE)
 
 // qemu puts programmable interrupt controller here.
 #define PLIC 0x0c000000L
@@ -62,6 +65,28 @@
 //   fixed-size stack
 //   expandable heap
 //   ...
+//   THREADFRAME(i) (trapframes of threads made by clone())
+//   AIORING (p->aring, if set up)
+//   USYSCALL (p->usyscall, read-only to the user)
 //   TRAPFRAME (p->trapframe, used by the trampoline)
 //   TRAMPOLINE (the same page as in the kernel)
 #define TRAPFRAME (TRAMPOLINE - PGSIZE)
+
+// kernel data that user code can read without a system call.
+#define USYSCALL (TRAPFRAME - PGSIZE)
+
+// asynchronous I/O rings (aio.h), if the process asked for them.
+#define AIORING (USYSCALL - PGSIZE)
+
+// the trapframe of a thread, which shares its leader's page
+// table; i is the thread's slot in proc[].
+#define THREADFRAME(i) (AIORING - ((i)+1)*PGSIZE)
+
+// the USYSCALL page. ticks and tickstamp are refreshed
+// on every return to user space.
+struct usyscall {
+  int pid;          // Process ID
+  uint ticks;       // as returned by uptime()
+  uint64 tickstamp; // time CSR when ticks last advanced
+  uint64 timebase;  // time CSR cycles per second
+};
@@ -7,7 +7,13 @@
 #define ROOTDEV       1  // device number of file system root disk
 #define MAXARG       32  // max exec arguments
 #define MAXOPBLOCKS  10  // max # of blocks any FS op writes  һ޸̿
-#define LOGSIZE      (MAXOPBLOCKS*3)  // max data blocks in on-disk log
-#define NBUF         (MAXOPBLOCKS*3)  // size of disk block cache
-#define FSSIZE       1000  // size of file system in blocks
+#define LOGSIZE      (MAXOPBLOCKS*6)  // max data blocks in on-disk log
+#define NBUF         (MAXOPBLOCKS*9)  // size of disk block cache
+#define FSSIZE       2000  // size of file system in blocks
 #define MAXPATH      128   // maximum file path name
+#define FLUSHTICKS   30    // ticks between background log checkpoints
+#define NAIOWORKER   2     // kernel processes running async I/O
+#define NAIOREQ      64    // async I/O requests queued system-wide
+#define NMLFQ        4     // scheduler priority levels
+#define BOOSTTICKS   30    // ticks between scheduler priority boosts
+#define NSYSCALL     45    // > highest system call number
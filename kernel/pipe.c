@@ -7,18 +7,56 @@
 #include "fs.h"
 #include "sleeplock.h"
 #include "file.h"
+#include "fcntl.h"
+#include "stats.h"
 
-#define PIPESIZE 512
+#define PIPEPAGES 16  // most pages in one pipe buffer
 
+// The buffer is a ring of size bytes spread over whole pages.
+// Readers and writers copy a page-contiguous span at a time,
+// and only wake the other side when the ring stops being
+// empty (for readers) or full (for writers).
 struct pipe {
   struct spinlock lock;
-  char data[PIPESIZE];
-  uint nread;     // number of bytes read
-  uint nwrite;    // number of bytes written
+  char *page[PIPEPAGES];
+  uint size;      // bytes in the ring, a multiple of PGSIZE
+  uint nread;     // number of bytes read, mod size (see pipeadvance())
+  uint nwrite;    // number of bytes written, less what nread dropped
   int readopen;   // read fd is still open
   int writeopen;  // write fd is still open
+  struct epitem *watch;  // epoll items watching this pipe (eplock)
 };
 
+// statistics, updated atomically since each pipe has its own lock.
+static uint npipe;          // pipes open
+static uint64 pipebytes;    // bytes written to all pipes
+
+// Return the address of ring position pos, and cut *n down
+// to the number of bytes contiguous with it.
+static char*
+pipeptr(struct pipe *pi, uint pos, int *n)
+{
+  uint off = pos % pi->size;
+
+  if(*n > PGSIZE - off % PGSIZE)
+    *n = PGSIZE - off % PGSIZE;
+  return pi->page[off / PGSIZE] + off % PGSIZE;
+}
+
+// m bytes have been read. Take size off both counts once
+// nread reaches it, so that they stay below 2*size: a size
+// that isn't a power of two doesn't divide 2^32, and counts
+// left to wrap there would jump to another ring position.
+static void
+pipeadvance(struct pipe *pi, int m)
+{
+  pi->nread += m;
+  if(pi->nread >= pi->size){
+    pi->nread -= pi->size;
+    pi->nwrite -= pi->size;
+  }
+}
+
 int
 pipealloc(struct file **f0, struct file **f1)
 {
@@ -30,6 +68,10 @@ pipealloc(struct file **f0, struct file **f1)
     goto bad;
   if((pi = (struct pipe*)kalloc()) == 0)
     goto bad;
+  memset(pi, 0, sizeof(*pi));
+  if((pi->page[0] = kalloc()) == 0)
+    goto bad;
+  pi->size = PGSIZE;
   pi->readopen = 1;
   pi->writeopen = 1;
   pi->nwrite = 0;
@@ -38,11 +80,14 @@ pipealloc(struct file **f0, struct file **f1)
   (*f0)->type = FD_PIPE;
   (*f0)->readable = 1;
   (*f0)->writable = 0;
+  (*f0)->nonblock = 0;
   (*f0)->pipe = pi;
   (*f1)->type = FD_PIPE;
   (*f1)->readable = 0;
   (*f1)->writable = 1;
+  (*f1)->nonblock = 0;
   (*f1)->pipe = pi;
+  __sync_fetch_and_add(&npipe, 1);
   return 0;
 
  bad:
@@ -55,6 +100,16 @@ pipealloc(struct file **f0, struct file **f1)
   return -1;
 }
 
+static void
+pipefree(struct pipe *pi)
+{
+  __sync_fetch_and_sub(&npipe, 1);
+  for(int i = 0; i < PIPEPAGES; i++)
+    if(pi->page[i])
+      kfree(pi->page[i]);
+  kfree((char*)pi);
+}
+
 void
 pipeclose(struct pipe *pi, int writable)
 {
@@ -62,66 +117,246 @@ pipeclose(struct pipe *pi, int writable)
   if(writable){
     pi->writeopen = 0;
     wakeup(&pi->nread);
+    epnotify(&pi->watch, POLLIN | POLLHUP);
   } else {
     pi->readopen = 0;
     wakeup(&pi->nwrite);
+    epnotify(&pi->watch, POLLHUP);
   }
   if(pi->readopen == 0 && pi->writeopen == 0){
     release(&pi->lock);
-    kfree((char*)pi);
+    pipefree(pi);
   } else
     release(&pi->lock);
 }
 
+int
+pipesize(struct pipe *pi)
+{
+  return pi->size;
+}
+
+// Make pi's buffer n bytes, rounded up to whole pages, keeping
+// whatever is buffered. Returns the new size, or -1 if n is out
+// of range, smaller than the buffered data, or memory is short.
+int
+piperesize(struct pipe *pi, int n)
+{
+  char *page[PIPEPAGES], *p;
+  int i, m, npage, old;
+  uint len, pos;
+
+  if(n <= 0 || n > PIPEPAGES*PGSIZE)
+    return -1;
+  npage = PGROUNDUP(n) / PGSIZE;
+  memset(page, 0, sizeof(page));
+  for(i = 0; i < npage; i++){
+    if((page[i] = kalloc()) == 0){
+      while(--i >= 0)
+        kfree(page[i]);
+      return -1;
+    }
+  }
+
+  acquire(&pi->lock);
+  len = pi->nwrite - pi->nread;
+  if(len > npage*PGSIZE){
+    release(&pi->lock);
+    for(i = 0; i < npage; i++)
+      kfree(page[i]);
+    return -1;
+  }
+  // copy the buffered bytes to the start of the new pages.
+  for(pos = 0; pos < len; pos += m){
+    m = len - pos;
+    p = pipeptr(pi, pi->nread + pos, &m);
+    if(m > PGSIZE - pos % PGSIZE)
+      m = PGSIZE - pos % PGSIZE;
+    memmove(page[pos / PGSIZE] + pos % PGSIZE, p, m);
+  }
+  old = pi->size / PGSIZE;
+  for(i = 0; i < PIPEPAGES; i++){
+    p = pi->page[i];
+    pi->page[i] = page[i];
+    page[i] = p;
+  }
+  pi->size = npage*PGSIZE;
+  pi->nread = 0;
+  pi->nwrite = len;
+  if(pi->size > len){
+    wakeup(&pi->nwrite);
+    epnotify(&pi->watch, POLLOUT);
+  }
+  release(&pi->lock);
+
+  for(i = 0; i < old; i++)
+    kfree(page[i]);
+  return pi->size;
+}
+
 int
 pipewrite(struct pipe *pi, uint64 addr, int n)
 {
-  int i;
-  char ch;
+  int i, m;
+  char *p;
   struct proc *pr = myproc();
 
   acquire(&pi->lock);
-  for(i = 0; i < n; i++){
-    while(pi->nwrite == pi->nread + PIPESIZE){  //DOC: pipewrite-full 
-      if(pi->readopen == 0 || pr->killed){
+  for(i = 0; i < n; i += m){
+    while(pi->nwrite == pi->nread + pi->size){  //DOC: pipewrite-full 
+      if(pi->readopen == 0 || iokilled()){
         release(&pi->lock);
         return -1;
       }
-      wakeup(&pi->nread);  // Ѷ
       sleep(&pi->nwrite, &pi->lock);  // ˯д
     }
-    if(copyin(pr->pagetable, &ch, addr + i, 1) == -1)
+    m = pi->size - (pi->nwrite - pi->nread);
+    if(m > n - i)
+      m = n - i;
+    p = pipeptr(pi, pi->nwrite, &m);
+    if(copyin(pr->pagetable, p, addr + i, m) == -1)
       break;
-    pi->data[pi->nwrite++ % PIPESIZE] = ch;
+    if(pi->nwrite == pi->nread){
+      wakeup(&pi->nread);  // Ѷ
+      epnotify(&pi->watch, POLLIN);
+    }
+    pi->nwrite += m;
   }
-  wakeup(&pi->nread);  // Ѷ
   release(&pi->lock);
+  __sync_fetch_and_add(&pipebytes, i);
   return i;
 }
 
 int
 piperead(struct pipe *pi, uint64 addr, int n)
 {
-  int i;
+  int i, m;
+  char *p;
   struct proc *pr = myproc();
-  char ch;
 
   acquire(&pi->lock);
   while(pi->nread == pi->nwrite && pi->writeopen){  //DOC: pipe-empty  
-    if(pr->killed){
+    if(iokilled()){
       release(&pi->lock);
       return -1;
     }
-    sleep(&pi->nread, &pi->lock); //DOC: piperead-sleep  ˯߶̣ʱûлдΪд̲û˯ߣΪд˯ߣô˵Ȼﲢûû
+    sleep(&pi->nread, &pi->lock); //DOC: piperead-sleep
   }
-  for(i = 0; i < n; i++){  //DOC: piperead-copy
-    if(pi->nread == pi->nwrite)
+  for(i = 0; i < n && pi->nread != pi->nwrite; i += m){  //DOC: piperead-copy
+    m = pi->nwrite - pi->nread;
+    if(m > n - i)
+      m = n - i;
+    p = pipeptr(pi, pi->nread, &m);
+    if(copyout(pr->pagetable, addr + i, p, m) == -1)
+      break;
+    if(pi->nwrite == pi->nread + pi->size){
+      wakeup(&pi->nwrite);  //DOC: piperead-wakeup
+      epnotify(&pi->watch, POLLOUT);
+    }
+    pipeadvance(pi, m);
+  }
+  release(&pi->lock);
+  return i;
+}
+
+// Report POLLIN, POLLOUT and POLLHUP for pi, and the
+// channels woken when they may change.
+int
+pipepoll(struct pipe *pi, void **chan)
+{
+  int mask = 0;
+
+  acquire(&pi->lock);
+  if(pi->nwrite != pi->nread || pi->writeopen == 0)
+    mask |= POLLIN;
+  if(pi->nwrite != pi->nread + pi->size && pi->readopen)
+    mask |= POLLOUT;
+  if(pi->writeopen == 0 || pi->readopen == 0)
+    mask |= POLLHUP;
+  release(&pi->lock);
+  chan[0] = &pi->nread;
+  chan[1] = &pi->nwrite;
+  return mask;
+}
+
+// The list of epoll items watching pi.
+struct epitem**
+pipewatch(struct pipe *pi)
+{
+  return &pi->watch;
+}
+
+// Wait until pi has data to read (write == 0) or room to
+// write (write == 1). Returns the number of bytes available,
+// 0 if there is no data and no writer, or -1 if there is no
+// reader or the caller has been killed (see iokilled()).
+int
+pipewait(struct pipe *pi, int write)
+{
+  int n;
+
+  acquire(&pi->lock);
+  for(;;){
+    if(iokilled() || (write && pi->readopen == 0)){
+      n = -1;
       break;
-    ch = pi->data[pi->nread++ % PIPESIZE];
-    if(copyout(pr->pagetable, addr + i, &ch, 1) == -1)
+    }
+    if(write)
+      n = pi->size - (pi->nwrite - pi->nread);
+    else
+      n = pi->nwrite - pi->nread;
+    if(n > 0 || (!write && pi->writeopen == 0))
       break;
+    sleep(write ? &pi->nwrite : &pi->nread, &pi->lock);
+  }
+  release(&pi->lock);
+  return n;
+}
+
+// Copy up to n bytes between kernel memory at p and pi,
+// into the pipe if write is set, else out of it. Never
+// sleeps; returns the number of bytes copied.
+int
+pipecopy(struct pipe *pi, char *p, int n, int write)
+{
+  int i, m;
+  char *q;
+
+  acquire(&pi->lock);
+  for(i = 0; i < n; i += m){
+    if(write){
+      if((m = pi->size - (pi->nwrite - pi->nread)) == 0)
+        break;
+      if(m > n - i)
+        m = n - i;
+      q = pipeptr(pi, pi->nwrite, &m);
+      memmove(q, p + i, m);
+      if(pi->nwrite == pi->nread){
+        wakeup(&pi->nread);
+        epnotify(&pi->watch, POLLIN);
+      }
+      pi->nwrite += m;
+    } else {
+      if((m = pi->nwrite - pi->nread) == 0)
+        break;
+      if(m > n - i)
+        m = n - i;
+      q = pipeptr(pi, pi->nread, &m);
+      memmove(p + i, q, m);
+      if(pi->nwrite == pi->nread + pi->size){
+        wakeup(&pi->nwrite);
+        epnotify(&pi->watch, POLLOUT);
+      }
+      pipeadvance(pi, m);
+    }
   }
-  wakeup(&pi->nwrite);  //DOC: piperead-wakeup 
   release(&pi->lock);
   return i;
 }
+
+void
+pipestats(struct kstats *ks)
+{
+  ks->npipe = npipe;
+  ks->pipebytes = pipebytes;
+}
@@ -1,5 +1,10 @@
 //
 // formatted console output -- printf, panic.
+// printf() appends to the kernel log (klog.c), from which the
+// UART interrupt sends it. It doesn't wait for other CPUs'
+// printing, but it does take uart_tx_lock briefly to kick the
+// UART (and, if its log ring is full, to drive it), so it
+// must not be called with uart_tx_lock held.
 //
 
 #include <stdarg.h>
@@ -14,25 +19,54 @@
 #include "riscv.h"
 #include "defs.h"
 #include "proc.h"
+#include "klog.h"
 
 volatile int panicked = 0;
-
-// lock to avoid interleaving concurrent printf's.
-static struct {
-  struct spinlock lock;
-  int locking;
-} pr;
+static volatile int panicker = -1;  // the CPU that panicked first
 
 static char digits[] = "0123456789abcdef";
 
+// printf() formats into one of these on its stack, and logs
+// a buffer-full at a time, as one kernel log record.
+struct out {
+  int n;
+  char buf[KLOGTEXT];
+};
+
 static void
-printint(int xx, int base, int sign)
+flushout(struct out *o)
 {
-  char buf[16];
+  if(o->n == 0)
+    return;
+  if(panicked){
+    // only the CPU that panicked prints; it drains
+    // the UART's buffers with no lock held.
+    if(cpuid() != panicker)
+      for(;;)
+        ;
+    uartflush(o->buf, o->n);
+  } else {
+    klogwrite(o->buf, o->n);
+  }
+  o->n = 0;
+}
+
+static void
+putc(struct out *o, int c)
+{
+  if(o->n == sizeof(o->buf))
+    flushout(o);
+  o->buf[o->n++] = c;
+}
+
+static void
+printint(struct out *o, uint64 xx, int base, int sign)
+{
+  char buf[24];
   int i;
-  uint x;
+  uint64 x;
 
-  if(sign && (sign = xx < 0))
+  if(sign && (sign = (long)xx < 0))
     x = -xx;
   else
     x = xx;
@@ -46,38 +80,41 @@ printint(int xx, int base, int sign)
     buf[i++] = '-';
 
   while(--i >= 0)
-    consputc(buf[i]);
+    putc(o, buf[i]);
 }
 
 static void
-printptr(uint64 x)
+printptr(struct out *o, uint64 x)
 {
   int i;
-  consputc('0');
-  consputc('x');
+  putc(o, '0');
+  putc(o, 'x');
   for (i = 0; i < (sizeof(uint64) * 2); i++, x <<= 4)
-    consputc(digits[x >> (sizeof(uint64) * 8 - 4)]);
+    putc(o, digits[x >> (sizeof(uint64) * 8 - 4)]);
 }
 
-// Print to the console. only understands %d, %x, %p, %s.
+// Print to the console. only understands %d, %l (uint64),
+// %x, %p, %s.
+// The output goes into this CPU's kernel log ring, to be sent
+// by interrupts, so printf() doesn't wait for the UART unless
+// that ring is full. Output of different CPUs may interleave
+// every KLOGTEXT bytes.
 void
 printf(char *fmt, ...)
 {
   va_list ap;
-  int i, c, locking;
+  int i, c;
   char *s;
-
-  locking = pr.locking;
-  if(locking)
-    acquire(&pr.lock);
+  struct out o;
 
   if (fmt == 0)
     panic("null fmt");
 
+  o.n = 0;
   va_start(ap, fmt);
   for(i = 0; (c = fmt[i] & 0xff) != 0; i++){
     if(c != '%'){
-      consputc(c);
+      putc(&o, c);
       continue;
     }
     c = fmt[++i] & 0xff;
@@ -85,50 +122,50 @@ printf(char *fmt, ...)
       break;
     switch(c){
     case 'd':
-      printint(va_arg(ap, int), 10, 1);
+      printint(&o, va_arg(ap, int), 10, 1);
+      break;
+    case 'l':
+      printint(&o, va_arg(ap, uint64), 10, 0);
       break;
     case 'x':
-      printint(va_arg(ap, int), 16, 1);
+      printint(&o, va_arg(ap, int), 16, 1);
       break;
     case 'p':
-      printptr(va_arg(ap, uint64));
+      printptr(&o, va_arg(ap, uint64));
       break;
     case 's':
       if((s = va_arg(ap, char*)) == 0)
         s = "(null)";
       for(; *s; s++)
-        consputc(*s);
+        putc(&o, *s);
       break;
     case '%':
-      consputc('%');
+      putc(&o, '%');
       break;
     default:
       // Print unknown % sequence to draw attention.
-      consputc('%');
-      consputc(c);
+      putc(&o, '%');
+      putc(&o, c);
       break;
     }
   }
-
-  if(locking)
-    release(&pr.lock);
+  flushout(&o);
+  if(!panicked)
+    uartkick();
 }
 
 void
 panic(char *s)
 {
-  pr.locking = 0;
+  intr_off();  // stay on this CPU
+  if(!__sync_bool_compare_and_swap(&panicker, -1, cpuid()))
+    for(;;)     // another CPU is panicking
+      ;
+  panicked = 1; // freeze uart output from other CPUs; print directly
   printf("panic: ");
   printf(s);
   printf("\n");
-  panicked = 1; // freeze uart output from other CPUs
   for(;;)
     ;
 }
 
-void
-printfinit(void)
-{
-  initlock(&pr.lock, "pr");
-  pr.locking = 1;
-}
@@ -5,6 +5,8 @@
 #include "spinlock.h"
 #include "proc.h"
 #include "defs.h"
+#include "ktrace.h"
+#include "stats.h"
 
 struct cpu cpus[NCPU];
 
@@ -16,9 +18,13 @@ int nextpid = 1;
 struct spinlock pid_lock;
 
 extern void forkret(void);
+static void kthreadret(void);
 static void wakeup1(struct proc *chan);
 static void freeproc(struct proc *p);
 
+// time slice, in clock ticks, at each MLFQ level.
+#define QUANTUM(level) (1 << (level))
+
 extern char trampoline[]; // trampoline.S
 
 // initialize the proc table at boot time.
@@ -30,6 +36,7 @@ procinit(void)  // Ϊproc
   initlock(&pid_lock, "nextpid");
   for(p = proc; p < &proc[NPROC]; p++) {
       initlock(&p->lock, "proc");
+      initlock(&p->sharelock, "share");
 
       // Allocate a page for the process's kernel stack.
       // Map it high in memory, followed by an invalid
@@ -106,6 +113,16 @@ allocproc(void)
 
 found:
   p->pid = allocpid();
+  p->leader = p;
+  p->ofile = p->ofiles;
+  p->tfva = TRAPFRAME;
+  p->level = 0;
+  p->qticks = 0;
+  p->nice = 0;
+  p->aiostop = 0;
+  p->aiofor = 0;
+  memset(p->nsys, 0, sizeof(p->nsys));
+  memset(p->syscycles, 0, sizeof(p->syscycles));
 
   // Allocate a trapframe page.
   if((p->trapframe = (struct trapframe *)kalloc()) == 0){
@@ -113,6 +130,16 @@ found:
     return 0;
   }
 
+  // Allocate the page of kernel data shared with the user.
+  if((p->usyscall = (struct usyscall *)kalloc()) == 0){
+    freeproc(p);
+    release(&p->lock);
+    return 0;
+  }
+  zero_page(p->usyscall);
+  p->usyscall->pid = p->pid;
+  p->usyscall->timebase = TIMEBASE;
+
   // An empty user page table.
   p->pagetable = proc_pagetable(p);
   if(p->pagetable == 0){
@@ -136,19 +163,41 @@ found:
 static void
 freeproc(struct proc *p)
 {
+  struct proc *l = p->leader;
+
+  if(l != 0 && l != p){
+    // a thread: the page table and USYSCALL page are l's.
+    acquire(&l->sharelock);
+    uvmunmap(p->pagetable, p->tfva, 1, 0);
+    l->nthread--;
+    release(&l->sharelock);
+    p->pagetable = 0;
+    p->usyscall = 0;
+  }
   if(p->trapframe)
     kfree((void*)p->trapframe);
   p->trapframe = 0;
+  if(p->usyscall)
+    kfree((void*)p->usyscall);
+  p->usyscall = 0;
   if(p->pagetable)
     proc_freepagetable(p->pagetable, p->sz);
   p->pagetable = 0;
   p->sz = 0;
   p->pid = 0;
   p->parent = 0;
+  p->leader = 0;
+  p->ofile = 0;
+  p->tfva = 0;
+  p->ustack = 0;
   p->name[0] = 0;
   p->chan = 0;
+  p->npollchan = 0;
   p->killed = 0;
   p->xstate = 0;
+  p->kfunc = 0;
+  p->aring = 0;
+  p->ainflight = 0;
   p->state = UNUSED;
 }
 
@@ -182,6 +231,15 @@ proc_pagetable(struct proc *p)  // Ϊһ
     return 0;
   }
 
+  // map the USYSCALL page just below TRAPFRAME, read-only.
+  if(mappages(pagetable, USYSCALL, PGSIZE,
+              (uint64)(p->usyscall), PTE_R | PTE_U) < 0){
+    uvmunmap(pagetable, TRAMPOLINE, 1, 0);
+    uvmunmap(pagetable, TRAPFRAME, 1, 0);
+    uvmfree(pagetable, 0);
+    return 0;
+  }
+
   return pagetable;
 }
 
@@ -192,6 +250,7 @@ proc_freepagetable(pagetable_t pagetable, uint64 sz)
 {
   uvmunmap(pagetable, TRAMPOLINE, 1, 0);  //Ҫɾľtrampolineµtrampolineָһطֻɾӳϵɾڴ棬Կproc_pagetable
   uvmunmap(pagetable, TRAPFRAME, 1, 0);  //ͬ
+  uvmunmap(pagetable, USYSCALL, 1, 0);
   uvmfree(pagetable, sz);
 }
 
@@ -233,24 +292,69 @@ userinit(void)
   release(&p->lock);   // ͷallocproc
 }
 
+// Start fn running in a new process that never returns to
+// user space, e.g. a background flusher.
+// Returns the new pid, or -1 on failure.
+int
+kthread(void (*fn)(void), char *name)
+{
+  struct proc *p;
+  int pid;
+
+  if((p = allocproc()) == 0)
+    return -1;
+  p->kfunc = fn;
+  p->context.ra = (uint64)kthreadret;
+  safestrcpy(p->name, name, sizeof(p->name));
+  pid = p->pid;
+  p->state = RUNNABLE;
+  release(&p->lock);
+  return pid;
+}
+
+// A kernel process's very first scheduling by
+// scheduler() will swtch here.
+static void
+kthreadret(void)
+{
+  // Still holding p->lock from scheduler.
+  release(&myproc()->lock);
+  myproc()->kfunc();
+  panic("kthread returned");
+}
+
 // Grow or shrink user memory by n bytes.
-// Return 0 on success, -1 on failure.
+// Return the old size, or -1 on failure.
 int
 growproc(int n)
 {
-  uint sz;
-  struct proc *p = myproc();
+  uint sz, oldsz;
+  struct proc *p = myproc()->leader;  // threads share its memory
 
-  sz = p->sz;
+  // an aio worker may be copying to or from the pages that
+  // would go. only p submits requests, so none can start
+  // once this finds none (aio.lock comes before sharelock).
+  if(n < 0 && aiobusy(p))
+    return -1;
+  acquire(&p->sharelock);
+  sz = oldsz = p->sz;
   if(n > 0){  //ڴ
     if((sz = uvmalloc(p->pagetable, sz, sz + n)) == 0) {
+      release(&p->sharelock);
       return -1;
     }
   } else if(n < 0){  //Сڴ
+    // nothing flushes the TLBs of other CPUs, where threads
+    // could go on using the freed pages.
+    if(p->nthread > 0){
+      release(&p->sharelock);
+      return -1;
+    }
     sz = uvmdealloc(p->pagetable, sz, sz + n);
   }
   p->sz = sz;
-  return 0;
+  release(&p->sharelock);
+  return oldsz;
 }
 
 // Create a new process, copying the parent.
@@ -261,6 +365,7 @@ fork(void)
   int i, pid;
   struct proc *np;
   struct proc *p = myproc();
+  struct proc *l = p->leader;
 
   // Allocate process.
   if((np = allocproc()) == 0){
@@ -268,12 +373,15 @@ fork(void)
   }
 
   // Copy user memory from parent to child.
-  if(uvmcopy(p->pagetable, np->pagetable, p->sz) < 0){  //ͬҳͬڴ棬ݵڴ
+  acquire(&l->sharelock);
+  if(uvmcopy(p->pagetable, np->pagetable, l->sz) < 0){
+    release(&l->sharelock);  //ͬҳͬڴ棬ݵڴ
     freeproc(np);
     release(&np->lock);
     return -1;
   }
-  np->sz = p->sz;
+  np->sz = l->sz;
+  release(&l->sharelock);
 
   np->parent = p;
 
@@ -287,7 +395,10 @@ fork(void)
   for(i = 0; i < NOFILE; i++)
     if(p->ofile[i])
       np->ofile[i] = filedup(p->ofile[i]);
-  np->cwd = idup(p->cwd);
+  np->cwd = cwdup(p);
+
+  np->nice = p->nice;
+  np->level = p->nice;
 
   safestrcpy(np->name, p->name, sizeof(p->name));
 
@@ -296,10 +407,169 @@ fork(void)
   np->state = RUNNABLE;   // ½̵stateΪRUNNABLEͿԱscheduler
 
   release(&np->lock);
+  kickidle();
 
   return pid;
 }
 
+// Create a thread that runs fn(arg) on the given user stack,
+// sharing the caller's memory, open files and current directory.
+// Returns the new thread's id, or -1.
+int
+clone(uint64 fn, uint64 arg, uint64 stack)
+{
+  int tid;
+  uint64 va;
+  struct proc *np;
+  struct proc *p = myproc();
+  struct proc *l = p->leader;
+
+  // a process with an async I/O ring stays single-threaded,
+  // as sys_aiosetup() requires, so that no thread's close()
+  // races an AIO_CLOSE.
+  if(l->aring)
+    return -1;
+
+  if((np = allocproc()) == 0)
+    return -1;
+
+  // run on l's page table and USYSCALL page, with np's
+  // trapframe mapped at a slot of its own.
+  proc_freepagetable(np->pagetable, 0);
+  np->pagetable = 0;
+  kfree((void*)np->usyscall);
+  np->usyscall = 0;
+  va = THREADFRAME(np - proc);
+  acquire(&l->sharelock);
+  if(mappages(l->pagetable, va, PGSIZE, (uint64)np->trapframe, PTE_R | PTE_W) < 0){
+    release(&l->sharelock);
+    freeproc(np);
+    release(&np->lock);
+    return -1;
+  }
+  l->nthread++;
+  release(&l->sharelock);
+  np->leader = l;
+  np->pagetable = l->pagetable;
+  np->usyscall = l->usyscall;
+  np->tfva = va;
+  np->ofile = l->ofile;
+  np->ustack = stack;
+
+  // start at fn with the caller's other registers. fn must
+  // not return: there is nowhere to return to.
+  *(np->trapframe) = *(p->trapframe);
+  np->trapframe->epc = fn;
+  np->trapframe->a0 = arg;
+  np->trapframe->sp = stack & ~0xfL;  // riscv sp must be 16-byte aligned
+  np->trapframe->ra = 0;
+
+  np->nice = p->nice;
+  np->level = p->nice;
+
+  // the leader joins every thread, whoever created it.
+  np->parent = l;
+  safestrcpy(np->name, l->name, sizeof(np->name));
+  tid = np->pid;
+  np->state = RUNNABLE;
+  release(&np->lock);
+  kickidle();
+  return tid;
+}
+
+// Wait for the caller's thread tid (any, if tid is 0) to exit,
+// free it, and copy the stack it was given by clone() out to
+// the user address stack, if non-zero. Returns the thread's id,
+// or -1 if there is no such thread. Only a leader has threads.
+int
+join(int tid, uint64 stack)
+{
+  struct proc *np;
+  int found, id;
+  struct proc *p = myproc();
+
+  acquire(&p->lock);
+  for(;;){
+    found = 0;
+    for(np = proc; np < &proc[NPROC]; np++){
+      if(np->parent == p && (tid == 0 || np->pid == tid)){
+        acquire(&np->lock);
+        if(np->leader != p){  // a child process, for wait()
+          release(&np->lock);
+          continue;
+        }
+        found = 1;
+        if(np->state == ZOMBIE){
+          id = np->pid;
+          if(stack != 0 && copyout(p->pagetable, stack, (char *)&np->ustack,
+                                   sizeof(np->ustack)) < 0){
+            release(&np->lock);
+            release(&p->lock);
+            return -1;
+          }
+          freeproc(np);
+          release(&np->lock);
+          release(&p->lock);
+          return id;
+        }
+        release(&np->lock);
+      }
+    }
+
+    if(!found || p->killed){
+      release(&p->lock);
+      return -1;
+    }
+    sleep(p, &p->lock);
+  }
+}
+
+// Kill p's threads and free them as they exit, so that
+// exit() can tear down what they shared.
+static void
+killthreads(struct proc *p)
+{
+  struct proc *np;
+  int n;
+
+  acquire(&p->lock);
+  for(;;){
+    n = 0;
+    for(np = proc; np < &proc[NPROC]; np++){
+      if(np->parent == p){
+        acquire(&np->lock);
+        if(np->leader == p && np->state == ZOMBIE){
+          freeproc(np);
+        } else if(np->leader == p){
+          np->killed = 1;
+          if(np->state == SLEEPING)
+            np->state = RUNNABLE;
+          n++;
+        }
+        release(&np->lock);
+      }
+    }
+    if(n == 0)
+      break;
+    sleep(p, &p->lock);  // a thread's exit() wakes us
+  }
+  release(&p->lock);
+}
+
+// Return a new reference to p's current directory,
+// which threads share with their leader.
+struct inode*
+cwdup(struct proc *p)
+{
+  struct proc *l = p->leader;
+  struct inode *ip;
+
+  acquire(&l->sharelock);
+  ip = idup(l->cwd);
+  release(&l->sharelock);
+  return ip;
+}
+
 // Pass p's abandoned children to init.
 // Caller must hold p->lock.
 void
@@ -337,19 +607,26 @@ exit(int status)  // 
   if(p == initproc)   // init̲˳
     panic("init exiting");
 
-  // Close all open files.
-  for(int fd = 0; fd < NOFILE; fd++){
-    if(p->ofile[fd]){
-      struct file *f = p->ofile[fd];
-      fileclose(f);   // ļü
-      p->ofile[fd] = 0;
+  if(p->leader == p){
+    // threads go first, since they use everything below.
+    if(p->nthread > 0)
+      killthreads(p);
+    aioexit(p);
+
+    // Close all open files.
+    for(int fd = 0; fd < NOFILE; fd++){
+      if(p->ofile[fd]){
+        struct file *f = p->ofile[fd];
+        fileclose(f);   // ļü
+        p->ofile[fd] = 0;
+      }
     }
-  }
 
-  begin_op();
-  iput(p->cwd);
-  end_op();
-  p->cwd = 0;
+    begin_op();
+    iput(p->cwd);
+    end_op();
+    p->cwd = 0;
+  }
 
   // we might re-parent a child to init. we can't be precise about
   // waking up init, since we can't acquire its lock once we've
@@ -416,6 +693,10 @@ wait(uint64 addr)  // 
         // np->parent can't change between the check and the acquire()
         // because only the parent changes it, and we're the parent.
         acquire(&np->lock);
+        if(np->leader != np){  // a thread, for join()
+          release(&np->lock);
+          continue;
+        }
         havekids = 1;
         if(np->state == ZOMBIE){
           // Found one.
@@ -446,10 +727,113 @@ wait(uint64 addr)  // 
   }
 }
 
+// The process to run next: the first runnable one in the
+// lowest-numbered MLFQ level, taking turns within each level.
+// Returns it with p->lock held, or 0 if none is runnable.
+static struct proc*
+pickproc(void)
+{
+  static int next[NMLFQ];  // where each level's turn resumes
+  struct proc *p;
+  int lev, i, k;
+
+  for(lev = 0; lev < NMLFQ; lev++){
+    for(k = 0; k < NPROC; k++){
+      i = (next[lev] + k) % NPROC;
+      p = &proc[i];
+      // look without the lock first; most slots won't do.
+      if(p->state != RUNNABLE || p->level != lev)
+        continue;
+      acquire(&p->lock);
+      if(p->state == RUNNABLE && p->level == lev){
+        next[lev] = i + 1;
+        return p;
+      }
+      release(&p->lock);
+    }
+  }
+  return 0;
+}
+
+// Charge the running process for a timer interrupt. Returns 1
+// if it should yield(): it has used up its time slice at this
+// level, and drops to the next, or a process in a higher level
+// is waiting to run.
+int
+schedtick(void)
+{
+  struct proc *p = myproc();
+  struct proc *q;
+  int lev;
+
+  acquire(&p->lock);
+  if(++p->qticks >= QUANTUM(p->level)){
+    p->qticks = 0;
+    if(p->level < NMLFQ-1)
+      p->level++;
+    release(&p->lock);
+    return 1;
+  }
+  lev = p->level;
+  release(&p->lock);
+  for(q = proc; q < &proc[NPROC]; q++)
+    if(q->state == RUNNABLE && q->level < lev)
+      return 1;
+  return 0;
+}
+
+// Move every process back up to its highest level, so that
+// CPU-bound ones in the lower levels aren't starved forever.
+// timerintr() calls this every BOOSTTICKS ticks.
+void
+mlfqboost(void)
+{
+  struct proc *p;
+
+  for(p = proc; p < &proc[NPROC]; p++){
+    acquire(&p->lock);
+    p->level = p->nice;
+    p->qticks = 0;
+    release(&p->lock);
+  }
+}
+
+// Set the nice value of process pid (the caller, if pid is 0):
+// the highest MLFQ level it may run at, from 0 to NMLFQ-1.
+// value -1 leaves it alone. Returns the old value, or -1.
+int
+setpriority(int pid, int value)
+{
+  struct proc *p;
+  int old;
+
+  if(value < -1 || value >= NMLFQ)
+    return -1;
+  if(pid == 0)
+    pid = myproc()->pid;
+  for(p = proc; p < &proc[NPROC]; p++){
+    acquire(&p->lock);
+    if(p->pid == pid && p->state != UNUSED){
+      old = p->nice;
+      if(value >= 0){
+        p->nice = value;
+        if(p->level < value){
+          p->level = value;
+          p->qticks = 0;
+        }
+      }
+      release(&p->lock);
+      return old;
+    }
+    release(&p->lock);
+  }
+  return -1;
+}
+
 // Per-CPU process scheduler.
 // Each CPU calls scheduler() after setting itself up.
 // Scheduler never returns.  It loops, doing:
-//  - choose a process to run.
+//  - choose a process to run (see pickproc()).
 //  - swtch to start running that process.
 //  - eventually that process transfers control
 //    via swtch back to the scheduler.
@@ -463,31 +847,34 @@ scheduler(void)   // ÿ
   for(;;){
     // Avoid deadlock by ensuring that devices can interrupt.
     intr_on();  // intr_onCPU˻жϣÿCPU˶
-    
-    int found = 0;
-    for(p = proc; p < &proc[NPROC]; p++) {
-      acquire(&p->lock);  // ʣҪȵĽ֮ǰѾȹˣôﱻͷأ
-      if(p->state == RUNNABLE) {
-        // Switch to chosen process.  It is the process's job
-        // to release its lock and then reacquire it
-        // before jumping back to us.
-        p->state = RUNNING;   // ý״̬Ϊ̬
-        c->proc = p;          // ½ϴ
-        swtch(&c->context, &p->context);  // ˴תû̶Ӧں˽ִ̼У
-        // ʱc->context.raеݾǵǰָһָĵַ
-
-        // Process is done running for now.
-        // It should have changed its p->state before coming back.
-        c->proc = 0;
 
-        found = 1;
-      }
-      release(&p->lock);
-    }
-    if(found == 0) {
-      intr_on();
+    // Look for a process and wait with interrupts off, so that
+    // a kickidle() or a wakeup by an interrupt can't slip in
+    // between the look and the wfi, which still returns at a
+    // pending interrupt; the next intr_on() takes it.
+    intr_off();
+    setidle(1);
+    if((p = pickproc()) == 0){
       asm volatile("wfi");
+      continue;
     }
+    setidle(0);
+    tickstart();  // so that p can be preempted
+
+    // Switch to chosen process.  It is the process's job
+    // to release its lock and then reacquire it
+    // before jumping back to us.
+    p->state = RUNNING;   // ý״̬Ϊ̬
+    c->proc = p;          // ½ϴ
+    c->nswitch++;
+    KTRACE(KT_SWITCH, p->level, 0);
+    swtch(&c->context, &p->context);  // ˴תû̶Ӧں˽ִ̼У
+    // ʱc->context.raеݾǵǰָһָĵַ
+
+    // Process is done running for now.
+    // It should have changed its p->state before coming back.
+    c->proc = 0;
+    release(&p->lock);
   }
 }
 
@@ -585,20 +972,86 @@ sleep(void *chan, struct spinlock *lk)  // 
   }
 }
 
+// Is chan one of the channels p registered with pollstart()?
+// Caller holds p->lock.
+static int
+pollmatch(struct proc *p, void *chan)
+{
+  for(int i = 0; i < p->npollchan; i++)
+    if(p->pollchan[i] == chan)
+      return 1;
+  return 0;
+}
+
+// Waiting on several channels at once, for poll().
+// After pollstart(), a wakeup() on any of chan[0..n) makes
+// the next pollsleep() return at once, so the caller can
+// check readiness after pollstart() without losing a change.
+void
+pollstart(void **chan, int n)
+{
+  struct proc *p = myproc();
+
+  acquire(&p->lock);
+  p->pollchan = chan;
+  p->npollchan = n;
+  p->pollwoken = 0;
+  release(&p->lock);
+}
+
+// Sleep until a registered channel is woken (or was, since
+// pollstart()), then unregister them all.
+void
+pollsleep(void)
+{
+  struct proc *p = myproc();
+
+  acquire(&p->lock);
+  if(!p->pollwoken && !p->killed){
+    p->chan = p->pollchan;
+    p->state = SLEEPING;
+    sched();
+    p->chan = 0;
+  }
+  p->npollchan = 0;
+  release(&p->lock);
+}
+
+// Unregister without sleeping.
+void
+pollend(void)
+{
+  struct proc *p = myproc();
+
+  acquire(&p->lock);
+  p->npollchan = 0;
+  release(&p->lock);
+}
+
 // Wake up all processes sleeping on chan.
 // Must be called without any p->lock.
 void
 wakeup(void *chan)
 {
   struct proc *p;
+  int woke = 0;
 
   for(p = proc; p < &proc[NPROC]; p++) {
     acquire(&p->lock);
     if(p->state == SLEEPING && p->chan == chan) {
       p->state = RUNNABLE;
+      woke = 1;
+    } else if(p->npollchan > 0 && pollmatch(p, chan)) {
+      p->pollwoken = 1;
+      if(p->state == SLEEPING && p->chan == p->pollchan){
+        p->state = RUNNABLE;
+        woke = 1;
+      }
     }
     release(&p->lock);
   }
+  if(woke)
+    kickidle();
 }
 
 // Wake up p if it is sleeping in wait(); used by exit().
@@ -633,6 +1086,7 @@ kill(int pid)   // kill
         p->state = RUNNABLE;
       }
       release(&p->lock);
+      kickidle();
       return 0;
     }
     release(&p->lock);
@@ -640,6 +1094,59 @@ kill(int pid)   // kill
   return -1;
 }
 
+// Should a read or write that waits give up? Yes once the
+// caller has been killed, or, in an async I/O worker, once
+// the process it is working for has been, or is dropping its
+// requests in aioexit().
+int
+iokilled(void)
+{
+  struct proc *p = myproc();
+
+  return p->killed ||
+         (p->aiofor && (p->aiofor->killed || p->aiofor->aiostop));
+}
+
+// Report how many times process pid has made system
+// call num, and the cycles spent in them.
+int
+procsysstat(int pid, int num, uint64 *n, uint64 *cycles)
+{
+  struct proc *p;
+
+  for(p = proc; p < &proc[NPROC]; p++){
+    acquire(&p->lock);
+    if(p->pid == pid && p->state != UNUSED){
+      *n = p->nsys[num];
+      *cycles = p->syscycles[num];
+      release(&p->lock);
+      return 0;
+    }
+    release(&p->lock);
+  }
+  return -1;
+}
+
+// Count the processes in use and those waiting to run,
+// and how often each CPU has switched to one.
+void
+procstats(struct kstats *ks)
+{
+  struct proc *p;
+  int i;
+
+  for(p = proc; p < &proc[NPROC]; p++){
+    acquire(&p->lock);
+    if(p->state != UNUSED)
+      ks->nproc++;
+    if(p->state == RUNNABLE)
+      ks->nrunnable++;
+    release(&p->lock);
+  }
+  for(i = 0; i < NCPU; i++)
+    ks->nswitch[i] = cpus[i].nswitch;
+}
+
 // Copy to either a user address, or kernel address,
 // depending on usr_dst.
 // Returns 0 on success, -1 on error.
@@ -695,7 +1202,7 @@ procdump(void)
       state = states[p->state];
     else
       state = "???";
-    printf("%d %s %s", p->pid, state, p->name);
+    printf("%d %s %s L%d", p->pid, state, p->name, p->level);
     printf("\n");
   }
 }
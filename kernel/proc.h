@@ -24,6 +24,7 @@ struct cpu {
   struct context context;     // swtch() here to enter scheduler().
   int noff;                   // Depth of push_off() nesting.
   int intena;                 // Were interrupts enabled before push_off()?
+  uint64 nswitch;             // processes switched to, for the stats device
 };
 
 extern struct cpu cpus[NCPU];
@@ -90,17 +91,40 @@ struct proc {
   enum procstate state;        // Process state
   struct proc *parent;         // Parent process
   void *chan;                  // If non-zero, sleeping on chan
+  void **pollchan;             // poll(): also woken by these channels
+  int npollchan;
+  int pollwoken;               // a pollchan was woken since pollstart()
   int killed;                  // If non-zero, have been killed
   int xstate;                  // Exit status to be returned to parent's wait
   int pid;                     // Process ID
+  int level;                   // MLFQ level; level 0 is scheduled first
+  int qticks;                  // clock ticks used at this level
+  int nice;                    // highest level allowed (setpriority())
+  struct proc *leader;         // Thread group leader (p itself unless made by clone())
 
   // these are private to the process, so p->lock need not be held.
   uint64 kstack;               // Virtual address of kernel stack
-  uint64 sz;                   // Size of process memory (bytes)
+  uint64 sz;                   // Size of process memory (bytes); threads use leader's
   pagetable_t pagetable;       // User page table
   struct trapframe *trapframe; // data page for trampoline.S
+  uint64 tfva;                 // where trapframe is mapped in the user page table
+  struct usyscall *usyscall;   // page mapped read-only at USYSCALL
   struct context context;      // swtch() here to run process
-  struct file *ofile[NOFILE];  // Open files   洢ǰ̴ļļָ룬еÿһ±궼һļ±ӦԪһfileָ룬ͰѽṹfileӦ
-  struct inode *cwd;           // Current directory ǰĿ¼inodeִļʱʹõ·ôЩcwdе
+  struct file *ofiles[NOFILE]; // descriptor table (unused by threads)
+  struct file **ofile;         // Open files: ofiles, or leader's   洢ǰ̴ļļָ룬еÿһ±궼һļ±ӦԪһfileָ룬ͰѽṹfileӦ
+  struct inode *cwd;           // Current directory; threads use leader's ǰĿ¼inodeִļʱʹõ·ôЩcwdе
   char name[16];               // Process name (debugging)
+  void (*kfunc)(void);         // Entry point of a kernel-only process
+  struct aio_ring *aring;      // Async I/O rings, mapped at AIORING
+  int ainflight;               // Async requests not yet completed (aio.lock)
+  int aiostop;                 // aioexit() is cancelling waiting requests
+  struct proc *aiofor;         // Async I/O worker: submitter of its request
+  uint nsys[NSYSCALL];         // system calls made, by number
+  uint64 syscycles[NSYSCALL];  // time spent in them (time CSR cycles)
+
+  // threads made by clone() share their leader's page table, sz,
+  // ofiles[] and cwd. the leader's sharelock guards these.
+  struct spinlock sharelock;
+  int nthread;                 // leader's threads not yet freed
+  uint64 ustack;               // a thread's stack, as given to clone()
 };
@@ -0,0 +1,132 @@
+//
+// Sampling profiler.
+// While profiling is on, each CPU arms a profiling timer (see
+// timer.c), and at each expiry profsample() records the
+// interrupted pc and process in that CPU's ring of samples.
+// A CPU joins in the next time it starts running a process.
+// prof() starts and stops profiling and drains the rings.
+//
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "defs.h"
+#include "prof.h"
+
+#define NPROFSAMPLE 1024  // per CPU
+
+struct {
+  struct spinlock lock;
+  struct profsample ring[NPROFSAMPLE];
+  uint head, tail;  // next to read, next to write
+  uint dropped;
+} prof[NCPU];
+
+int profiling;
+uint64 profcycles;  // sampling interval
+
+void
+profinit(void)
+{
+  for(int i = 0; i < NCPU; i++)
+    initlock(&prof[i].lock, "prof");
+}
+
+// Record where this CPU was when the profiling timer fired.
+// Called from timerintr(), with interrupts off.
+void
+profsample(void)
+{
+  struct proc *p = myproc();
+  struct profsample *s;
+  int id = cpuid();
+
+  acquire(&prof[id].lock);
+  if(prof[id].tail - prof[id].head == NPROFSAMPLE){
+    prof[id].dropped++;
+    release(&prof[id].lock);
+    return;
+  }
+  s = &prof[id].ring[prof[id].tail++ % NPROFSAMPLE];
+  s->pc = r_sepc();
+  s->user = (r_sstatus() & SSTATUS_SPP) == 0;
+  s->cpu = id;
+  s->pad = 0;
+  if(p){
+    s->pid = p->pid;
+    safestrcpy(s->name, p->name, sizeof(s->name));
+  } else {
+    s->pid = 0;
+    safestrcpy(s->name, "idle", sizeof(s->name));
+  }
+  release(&prof[id].lock);
+}
+
+// Copy up to n samples out to user address dst.
+static int
+profread(uint64 dst, int n)
+{
+  struct profsample s;
+  int i, got;
+
+  got = 0;
+  for(i = 0; i < NCPU && got < n; i++){
+    for(;;){
+      acquire(&prof[i].lock);
+      if(prof[i].head == prof[i].tail){
+        release(&prof[i].lock);
+        break;
+      }
+      s = prof[i].ring[prof[i].head++ % NPROFSAMPLE];
+      release(&prof[i].lock);
+      if(copyout(myproc()->pagetable, dst + got*sizeof(s), (char*)&s, sizeof(s)) < 0)
+        return -1;
+      if(++got == n)
+        break;
+    }
+  }
+  return got;
+}
+
+// prof(cmd, arg, buf): see prof.h.
+uint64
+sys_prof(void)
+{
+  uint64 buf;
+  int cmd, arg, i;
+  uint dropped;
+
+  if(argint(0, &cmd) < 0 || argint(1, &arg) < 0 || argaddr(2, &buf) < 0)
+    return -1;
+  switch(cmd){
+  case PROF_START:
+    if(arg < PROF_MININTERVAL)
+      return -1;
+    for(i = 0; i < NCPU; i++){
+      acquire(&prof[i].lock);
+      prof[i].head = prof[i].tail = prof[i].dropped = 0;
+      release(&prof[i].lock);
+    }
+    profcycles = (uint64)arg * (TIMEBASE / 1000000);
+    __sync_synchronize();
+    profiling = 1;
+    push_off();
+    tickstart();  // this CPU starts sampling now
+    pop_off();
+    return 0;
+  case PROF_STOP:
+    profiling = 0;
+    dropped = 0;
+    for(i = 0; i < NCPU; i++)
+      dropped += prof[i].dropped;
+    return dropped;
+  case PROF_READ:
+    if(arg < 0)
+      return -1;
+    return profread(buf, arg);
+  }
+  return -1;
+}
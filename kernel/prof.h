@@ -0,0 +1,22 @@
+// Sampling profiler (prof()). While it runs, each CPU records
+// where it was every interval microseconds, from the timer
+// interrupt; prof() drains the samples.
+
+// prof(cmd, arg, buf) commands.
+#define PROF_START 1  // arg: sampling interval in microseconds,
+                      // at least PROF_MININTERVAL
+#define PROF_STOP  2  // returns how many samples were dropped
+#define PROF_READ  3  // copy up to arg samples to buf; returns how many
+
+// shorter intervals leave the CPUs little time for anything
+// but timer interrupts.
+#define PROF_MININTERVAL 100
+
+struct profsample {
+  uint64 pc;      // sepc when the timer interrupt arrived
+  int pid;        // 0 if the CPU was idle
+  short cpu;
+  char user;      // pc is a user address
+  char pad;
+  char name[16];  // the process's name, to find its binary
+};
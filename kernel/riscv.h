@@ -248,6 +248,24 @@ r_mcounteren()
   return x;
 }
 
+// Supervisor Counter-Enable
+static inline void
+w_scounteren(uint64 x)
+{
+  asm volatile("csrw scounteren, %0" : : "r" (x));
+}
+
+static inline uint64
+r_scounteren()
+{
+  uint64 x;
+  asm volatile("csrr %0, scounteren" : "=r" (x) );
+  return x;
+}
+
+// counter-enable bit for the time CSR.
+#define COUNTEREN_TM (1L << 1)
+
 // machine-mode cycle counter
 static inline uint64
 r_time()
@@ -0,0 +1,46 @@
+//
+// The stats device: read-only, each read() returns a snapshot
+// of the counters the memory, scheduler, buffer cache, log,
+// disk and pipe code keep (see stats.h). Each subsystem fills
+// in its own part, under its own lock, so the snapshot is not
+// taken at a single instant.
+//
+
+#include "types.h"
+#include "param.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "fs.h"
+#include "file.h"
+#include "defs.h"
+#include "stats.h"
+
+// Copy a snapshot to dst, a user address if user_dst.
+// n must leave room for all of it.
+int
+statsread(int user_dst, uint64 dst, int n)
+{
+  struct kstats ks;
+
+  if(n < 0 || n < (int)sizeof(ks))
+    return -1;
+  memset(&ks, 0, sizeof(ks));
+  ks.time = r_time();
+  kmemstats(&ks);
+  procstats(&ks);
+  timerstats(&ks);
+  bstats(&ks);
+  logstats(&ks);
+  virtio_disk_stats(&ks);
+  pipestats(&ks);
+  if(either_copyout(user_dst, dst, &ks, sizeof(ks)) < 0)
+    return -1;
+  return sizeof(ks);
+}
+
+void
+statsinit(void)
+{
+  devsw[STATS].read = statsread;
+}
@@ -0,0 +1,33 @@
+// Kernel statistics, from the read-only stats device (major
+// STATS). Each read() of sizeof(struct kstats) bytes returns a
+// new snapshot; counters count from boot.
+
+struct kstats {
+  uint64 time;            // time CSR when the snapshot was taken
+
+  // memory
+  uint freepages;         // pages kalloc() has free
+  uint totalpages;        // pages kalloc() manages
+
+  // scheduler
+  uint nproc;             // processes and threads in use
+  uint nrunnable;         // of those, waiting for a CPU
+  uint64 idle[NCPU];      // time CSR cycles each CPU has been idle
+  uint64 nswitch[NCPU];   // times each CPU has switched to a process
+
+  // buffer cache
+  uint64 bhits;           // block lookups found in the cache
+  uint64 bmisses;         // and not found
+
+  // log
+  uint64 ncommit;         // group commits
+  uint64 nlogged;         // blocks written to the log
+
+  // disk
+  uint64 nreq;            // requests given to the device
+  uint64 nblock;          // blocks transferred by them
+
+  // pipes
+  uint npipe;             // pipes open
+  uint64 pipebytes;       // bytes written to pipes
+};
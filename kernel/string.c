@@ -1,13 +1,48 @@
 #include "types.h"
+#include "riscv.h"
+
+// memset, memmove and memcmp work a 64-bit word at a time once
+// the pointers are word-aligned, eight words per iteration while
+// there is room. RISC-V traps on misaligned words, so when dst
+// and src can't be aligned together they go a byte at a time.
+
+#define WSIZE sizeof(uint64)
+#define ALIGNED(p) (((uint64)(p) & (WSIZE-1)) == 0)
+
+// Copy 8 words. All are loaded before any is stored, so this
+// is safe for overlapping blocks too.
+static inline void
+copy8(uint64 *d, const uint64 *s)
+{
+  uint64 w0 = s[0], w1 = s[1], w2 = s[2], w3 = s[3];
+  uint64 w4 = s[4], w5 = s[5], w6 = s[6], w7 = s[7];
+
+  d[0] = w0; d[1] = w1; d[2] = w2; d[3] = w3;
+  d[4] = w4; d[5] = w5; d[6] = w6; d[7] = w7;
+}
 
 void*
 memset(void *dst, int c, uint n)
 {
   char *cdst = (char *) dst;
-  int i;
-  for(i = 0; i < n; i++){
-    cdst[i] = c;
+  uint64 w, *wdst;
+
+  for(; n > 0 && !ALIGNED(cdst); n--)
+    *cdst++ = c;
+  w = (uchar)c;
+  w |= w << 8;
+  w |= w << 16;
+  w |= w << 32;
+  wdst = (uint64 *) cdst;
+  for(; n >= 8*WSIZE; n -= 8*WSIZE, wdst += 8){
+    wdst[0] = w; wdst[1] = w; wdst[2] = w; wdst[3] = w;
+    wdst[4] = w; wdst[5] = w; wdst[6] = w; wdst[7] = w;
   }
+  for(; n >= WSIZE; n -= WSIZE)
+    *wdst++ = w;
+  cdst = (char *) wdst;
+  while(n-- > 0)
+    *cdst++ = c;
   return dst;
 }
 
@@ -18,6 +53,14 @@ memcmp(const void *v1, const void *v2, uint n)
 
   s1 = v1;
   s2 = v2;
+  if((((uint64)s1 ^ (uint64)s2) & (WSIZE-1)) == 0){
+    for(; n > 0 && !ALIGNED(s1); n--, s1++, s2++)
+      if(*s1 != *s2)
+        return *s1 - *s2;
+    // skip equal words; the bytes below find the difference.
+    for(; n >= WSIZE && *(uint64*)s1 == *(uint64*)s2; n -= WSIZE)
+      s1 += WSIZE, s2 += WSIZE;
+  }
   while(n-- > 0){
     if(*s1 != *s2)
       return *s1 - *s2;
@@ -32,21 +75,70 @@ memmove(void *dst, const void *src, uint n)
 {
   const char *s;
   char *d;
+  int wide;
 
   s = src;
   d = dst;
+  wide = (((uint64)s ^ (uint64)d) & (WSIZE-1)) == 0;
   if(s < d && s + n > d){
+    // dst overlaps the end of src: copy backwards.
     s += n;
     d += n;
+    if(wide){
+      for(; n > 0 && !ALIGNED(d); n--)
+        *--d = *--s;
+      for(; n >= 8*WSIZE; n -= 8*WSIZE){
+        s -= 8*WSIZE;
+        d -= 8*WSIZE;
+        copy8((uint64*)d, (const uint64*)s);
+      }
+      for(; n >= WSIZE; n -= WSIZE){
+        s -= WSIZE;
+        d -= WSIZE;
+        *(uint64*)d = *(const uint64*)s;
+      }
+    }
     while(n-- > 0)
       *--d = *--s;
-  } else
+  } else {
+    if(wide){
+      for(; n > 0 && !ALIGNED(d); n--)
+        *d++ = *s++;
+      for(; n >= 8*WSIZE; n -= 8*WSIZE, s += 8*WSIZE, d += 8*WSIZE)
+        copy8((uint64*)d, (const uint64*)s);
+      for(; n >= WSIZE; n -= WSIZE, s += WSIZE, d += WSIZE)
+        *(uint64*)d = *(const uint64*)s;
+    }
     while(n-- > 0)
       *d++ = *s++;
+  }
 
   return dst;
 }
 
+// Copy a page. dst and src must be page-aligned.
+void
+copy_page(void *dst, const void *src)
+{
+  uint64 *d = dst;
+  const uint64 *s = src;
+
+  for(int i = 0; i < PGSIZE/WSIZE; i += 8)
+    copy8(d + i, s + i);
+}
+
+// Zero a page. dst must be page-aligned.
+void
+zero_page(void *dst)
+{
+  uint64 *d = dst;
+
+  for(int i = 0; i < PGSIZE/WSIZE; i += 8){
+    d[i+0] = 0; d[i+1] = 0; d[i+2] = 0; d[i+3] = 0;
+    d[i+4] = 0; d[i+5] = 0; d[i+6] = 0; d[i+7] = 0;
+  }
+}
+
 // memcpy exists to placate GCC.  Use memmove.
 void*
 memcpy(void *dst, const void *src, uint n)
@@ -6,13 +6,15 @@
 #include "proc.h"
 #include "syscall.h"
 #include "defs.h"
+#include "ktrace.h"
 
 // Fetch the uint64 at addr from the current process.
 int
 fetchaddr(uint64 addr, uint64 *ip)
 {
   struct proc *p = myproc();
-  if(addr >= p->sz || addr+sizeof(uint64) > p->sz)
+  uint64 sz = p->leader->sz;
+  if(addr >= sz || addr+sizeof(uint64) > sz)
     return -1;
   if(copyin(p->pagetable, (char *)ip, addr, sizeof(*ip)) != 0)
     return -1;
@@ -104,8 +106,31 @@ extern uint64 sys_unlink(void);
 extern uint64 sys_wait(void);
 extern uint64 sys_write(void);
 extern uint64 sys_uptime(void);
+extern uint64 sys_aiosetup(void);
+extern uint64 sys_aioenter(void);
+extern uint64 sys_readv(void);
+extern uint64 sys_writev(void);
+extern uint64 sys_pread(void);
+extern uint64 sys_pwrite(void);
+extern uint64 sys_lseek(void);
+extern uint64 sys_splice(void);
+extern uint64 sys_fcntl(void);
+extern uint64 sys_poll(void);
+extern uint64 sys_epoll_create(void);
+extern uint64 sys_epoll_ctl(void);
+extern uint64 sys_epoll_wait(void);
+extern uint64 sys_clone(void);
+extern uint64 sys_join(void);
+extern uint64 sys_futex_wait(void);
+extern uint64 sys_futex_wake(void);
+extern uint64 sys_setpriority(void);
+extern uint64 sys_nanosleep(void);
+extern uint64 sys_prof(void);
+extern uint64 sys_ktrace(void);
+extern uint64 sys_sysstat(void);
+extern uint64 sys_dmesg(void);
 
-static uint64 (*syscalls[])(void) = {
+static uint64 (*syscalls[NSYSCALL])(void) = {
 [SYS_fork]    sys_fork,
 [SYS_exit]    sys_exit,
 [SYS_wait]    sys_wait,
@@ -127,19 +152,47 @@ static uint64 (*syscalls[])(void) = {
 [SYS_link]    sys_link,
 [SYS_mkdir]   sys_mkdir,
 [SYS_close]   sys_close,
+[SYS_aiosetup] sys_aiosetup,
+[SYS_aioenter] sys_aioenter,
+[SYS_readv]   sys_readv,
+[SYS_writev]  sys_writev,
+[SYS_pread]   sys_pread,
+[SYS_pwrite]  sys_pwrite,
+[SYS_lseek]   sys_lseek,
+[SYS_splice]  sys_splice,
+[SYS_fcntl]   sys_fcntl,
+[SYS_poll]    sys_poll,
+[SYS_epoll_create] sys_epoll_create,
+[SYS_epoll_ctl]    sys_epoll_ctl,
+[SYS_epoll_wait]   sys_epoll_wait,
+[SYS_clone]  sys_clone,
+[SYS_join]   sys_join,
+[SYS_futex_wait] sys_futex_wait,
+[SYS_futex_wake] sys_futex_wake,
+[SYS_setpriority] sys_setpriority,
+[SYS_nanosleep] sys_nanosleep,
+[SYS_prof]   sys_prof,
+[SYS_ktrace] sys_ktrace,
+[SYS_sysstat] sys_sysstat,
+[SYS_dmesg]  sys_dmesg,
 };
 
 void
 syscall(void)
 {
   int num;
+  uint64 t0;
   struct proc *p = myproc();
 
   num = p->trapframe->a7;
   if(num > 0 && num < NELEM(syscalls) && syscalls[num]) {
+    KTRACE(KT_SYSCALL, num, p->trapframe->a0);
+    t0 = r_time();
     p->trapframe->a0 = syscalls[num]();  
     // ϵͳõķֵ洢p->trapframe->a0УȻusertrapretٴ浽a0Ĵ
     // ûΪa0Ĵеֵϵͳõķֵ
+    sysstatrec(p, num, r_time() - t0);
+    KTRACE(KT_SYSRET, num, p->trapframe->a0);
   } else {
     printf("%d %s: unknown sys call %d\n",
             p->pid, p->name, num);
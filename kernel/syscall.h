@@ -20,3 +20,26 @@
 #define SYS_link   19
 #define SYS_mkdir  20
 #define SYS_close  21
+#define SYS_aiosetup 22
+#define SYS_aioenter 23
+#define SYS_readv  24
+#define SYS_writev 25
+#define SYS_pread  26
+#define SYS_pwrite 27
+#define SYS_lseek  28
+#define SYS_splice 29
+#define SYS_fcntl  30
+#define SYS_poll   31
+#define SYS_epoll_create 32
+#define SYS_epoll_ctl    33
+#define SYS_epoll_wait   34
+#define SYS_clone  35
+#define SYS_join   36
+#define SYS_futex_wait 37
+#define SYS_futex_wake 38
+#define SYS_setpriority 39
+#define SYS_nanosleep 40
+#define SYS_prof   41
+#define SYS_ktrace 42
+#define SYS_sysstat 43
+#define SYS_dmesg  44
@@ -15,9 +15,30 @@
 #include "sleeplock.h"
 #include "file.h"
 #include "fcntl.h"
+#include "memlayout.h"
+#include "timer.h"
+
+// The file open as descriptor fd, with a reference of the
+// caller's own to drop with fileclose(), or 0. Another thread
+// may close fd meanwhile, which then drops only the table's.
+struct file*
+fdget(int fd)
+{
+  struct proc *p = myproc();
+  struct file *f;
+
+  if(fd < 0 || fd >= NOFILE)
+    return 0;
+  acquire(&p->leader->sharelock);
+  if((f = p->ofile[fd]) != 0)
+    filedup(f);
+  release(&p->leader->sharelock);
+  return f;
+}
 
 // Fetch the nth word-sized system call argument as a file descriptor
-// and return both the descriptor and the corresponding struct file.
+// and return both the descriptor and the corresponding struct file,
+// which the caller must fileclose() when done (see fdget()).
 // ȡļļָ룬ɹ0ʧܷ-1
 static int
 argfd(int n, int *pfd, struct file **pf)
@@ -27,33 +48,43 @@ argfd(int n, int *pfd, struct file **pf)
 
   if(argint(n, &fd) < 0)  // ȡļfd
     return -1;
-  if(fd < 0 || fd >= NOFILE || (f=myproc()->ofile[fd]) == 0)  // ֤ļĺϷ
+  if((f = fdget(fd)) == 0)  // ֤ļĺϷ
     return -1;
   if(pfd)  //pfdΪգͰļpfd
     *pfd = fd;
-  if(pf)   //pfΪգͰļָ뱣pf
-    *pf = f;
+  *pf = f;
   return 0;
 }
 
-// Allocate a file descriptor for the given file.
+// Allocate a file descriptor in p for the given file.
 // Takes over file reference from caller on success.
 // ȡ̵һеfdļļָ洢ļ
-static int
-fdalloc(struct file *f)
+int
+fdinstall(struct proc *p, struct file *f)
 {
   int fd;
-  struct proc *p = myproc();
+  struct proc *l = p->leader;
 
+  // an aio worker may install descriptors for p (see aio.c),
+  // and p's threads share its table.
+  acquire(&l->sharelock);
   for(fd = 0; fd < NOFILE; fd++){
     if(p->ofile[fd] == 0){
       p->ofile[fd] = f;
+      release(&l->sharelock);
       return fd;
     }
   }
+  release(&l->sharelock);
   return -1;
 }
 
+static int
+fdalloc(struct file *f)
+{
+  return fdinstall(myproc(), f);
+}
+
 // ָļٸһ
 uint64
 sys_dup(void)
@@ -61,11 +92,12 @@ sys_dup(void)
   struct file *f;
   int fd;
 
-  if(argfd(0, 0, &f) < 0)
+  if(argfd(0, 0, &f) < 0)  // argfd()ļü
     return -1;
-  if((fd=fdalloc(f)) < 0)  // ļfdָļf
+  if((fd=fdalloc(f)) < 0){  // ļfdָļf
+    fileclose(f);
     return -1;
-  filedup(f); // ļü
+  }
   return fd;
 }
 
@@ -74,12 +106,14 @@ uint64
 sys_read(void)
 {
   struct file *f;
-  int n;
+  int n, r;
   uint64 p;
 
-  if(argfd(0, 0, &f) < 0 || argint(2, &n) < 0 || argaddr(1, &p) < 0)
+  if(argint(2, &n) < 0 || argaddr(1, &p) < 0 || argfd(0, 0, &f) < 0)
     return -1;
-  return fileread(f, p, n);
+  r = fileread(f, p, n);
+  fileclose(f);
+  return r;
 }
 
 // дļԴַֽ
@@ -87,13 +121,245 @@ uint64
 sys_write(void)
 {
   struct file *f; // ļ
-  int n;  // ַ
+  int n, r;  // ַ
   uint64 p;  // ַַ
 
-  if(argfd(0, 0, &f) < 0 || argint(2, &n) < 0 || argaddr(1, &p) < 0)
+  if(argint(2, &n) < 0 || argaddr(1, &p) < 0 || argfd(0, 0, &f) < 0)
+    return -1;
+
+  r = filewrite(f, p, n);
+  fileclose(f);
+  return r;
+}
+
+// Fetch a user array of cnt iovecs, whose address is the nth
+// system call argument.
+static int
+argiov(int n, struct iovec *iov, int cnt)
+{
+  uint64 uiov;
+
+  if(argaddr(n, &uiov) < 0 || cnt < 0 || cnt > IOV_MAX)
+    return -1;
+  return copyin(myproc()->pagetable, (char*)iov, uiov, cnt*sizeof(struct iovec));
+}
+
+// readv(fd, iov, cnt)
+uint64
+sys_readv(void)
+{
+  struct file *f;
+  struct iovec iov[IOV_MAX];
+  int cnt, r;
+
+  if(argint(2, &cnt) < 0 || argiov(1, iov, cnt) < 0 || argfd(0, 0, &f) < 0)
+    return -1;
+  r = filereadv(f, iov, cnt, -1);
+  fileclose(f);
+  return r;
+}
+
+// writev(fd, iov, cnt)
+uint64
+sys_writev(void)
+{
+  struct file *f;
+  struct iovec iov[IOV_MAX];
+  int cnt, r;
+
+  if(argint(2, &cnt) < 0 || argiov(1, iov, cnt) < 0 || argfd(0, 0, &f) < 0)
+    return -1;
+  r = filewritev(f, iov, cnt, -1);
+  fileclose(f);
+  return r;
+}
+
+// pread(fd, buf, n, off): read at off without moving the file offset.
+uint64
+sys_pread(void)
+{
+  struct file *f;
+  struct iovec iov;
+  uint64 p;
+  int n, off, r;
+
+  if(argaddr(1, &p) < 0 || argint(2, &n) < 0 || argint(3, &off) < 0 ||
+     off < 0 || argfd(0, 0, &f) < 0)
+    return -1;
+  iov.iov_base = (void*)p;
+  iov.iov_len = n;
+  r = filereadv(f, &iov, 1, off);
+  fileclose(f);
+  return r;
+}
+
+// pwrite(fd, buf, n, off): write at off without moving the file offset.
+uint64
+sys_pwrite(void)
+{
+  struct file *f;
+  struct iovec iov;
+  uint64 p;
+  int n, off, r;
+
+  if(argaddr(1, &p) < 0 || argint(2, &n) < 0 || argint(3, &off) < 0 ||
+     off < 0 || argfd(0, 0, &f) < 0)
+    return -1;
+  iov.iov_base = (void*)p;
+  iov.iov_len = n;
+  r = filewritev(f, &iov, 1, off);
+  fileclose(f);
+  return r;
+}
+
+// lseek(fd, off, whence): set the file offset and return it.
+// There are no holes, so the new offset can't be past the end.
+uint64
+sys_lseek(void)
+{
+  struct file *f;
+  int off, whence, base;
+
+  if(argint(1, &off) < 0 || argint(2, &whence) < 0 || argfd(0, 0, &f) < 0)
+    return -1;
+  if(f->type != FD_INODE){
+    fileclose(f);
+    return -1;
+  }
+
+  ilock(f->ip);
+  if(whence == SEEK_SET)
+    base = 0;
+  else if(whence == SEEK_CUR)
+    base = f->off;
+  else if(whence == SEEK_END)
+    base = f->ip->size;
+  else
+    base = -1;
+  if(base < 0 || base + off < 0 || base + off > f->ip->size){
+    iunlock(f->ip);
+    fileclose(f);
+    return -1;
+  }
+  f->off = off = base + off;
+  iunlock(f->ip);
+  fileclose(f);
+  return off;
+}
+
+// splice(fdin, fdout, n): move up to n bytes from fdin to
+// fdout inside the kernel.
+uint64
+sys_splice(void)
+{
+  struct file *in, *out;
+  int n, r;
+
+  if(argint(2, &n) < 0 || argfd(0, 0, &in) < 0)
+    return -1;
+  if(argfd(1, 0, &out) < 0){
+    fileclose(in);
+    return -1;
+  }
+  r = filesplice(in, out, n);
+  fileclose(in);
+  fileclose(out);
+  return r;
+}
+
+// fcntl(fd, cmd, arg): get or set per-file settings.
+uint64
+sys_fcntl(void)
+{
+  struct file *f;
+  int cmd, arg, r;
+
+  if(argint(1, &cmd) < 0 || argint(2, &arg) < 0 || argfd(0, 0, &f) < 0)
     return -1;
+  r = -1;
+  switch(cmd){
+  case F_GETPIPE_SZ:
+    if(f->type == FD_PIPE)
+      r = pipesize(f->pipe);
+    break;
+  case F_SETPIPE_SZ:
+    if(f->type == FD_PIPE)
+      r = piperesize(f->pipe, arg);
+    break;
+  case F_GETFL:
+    r = (f->readable && f->writable ? O_RDWR : f->writable ? O_WRONLY : O_RDONLY) |
+        (f->nonblock ? O_NONBLOCK : 0);
+    break;
+  case F_SETFL:
+    f->nonblock = (arg & O_NONBLOCK) != 0;
+    r = 0;
+    break;
+  }
+  fileclose(f);
+  return r;
+}
+
+// poll(fds, nfds, timeout): wait until one of the nfds
+// descriptors in fds is ready for the requested events, or
+// timeout ticks pass (never if timeout < 0). Sets each
+// revents and returns how many are non-zero.
+uint64
+sys_poll(void)
+{
+  struct proc *p = myproc();
+  struct pollfd fds[NOFILE];
+  void *chan[2*NOFILE+1], *unused[2];
+  struct file *f;
+  struct timer t;
+  uint64 ufds;
+  int i, nfds, timeout, nchan, ready, expired;
+
+  if(argaddr(0, &ufds) < 0 || argint(1, &nfds) < 0 || argint(2, &timeout) < 0)
+    return -1;
+  if(nfds < 0 || nfds > NOFILE ||
+     copyin(p->pagetable, (char*)fds, ufds, nfds*sizeof(fds[0])) < 0)
+    return -1;
+
+  if(timeout > 0)
+    timerset(&t, r_time() + (uint64)timeout * TICKCYCLES);
+  for(;;){
+    // listen for changes before looking, so none is missed.
+    nchan = 0;
+    for(i = 0; i < nfds; i++){
+      if((f = fdget(fds[i].fd)) != 0){
+        filepoll(f, chan + nchan);
+        fileclose(f);
+        nchan += 2;
+      }
+    }
+    if(timeout > 0)
+      chan[nchan++] = &t;
+    pollstart(chan, nchan);
+
+    ready = 0;
+    for(i = 0; i < nfds; i++){
+      if((f = fdget(fds[i].fd)) == 0)
+        fds[i].revents = POLLNVAL;
+      else {
+        fds[i].revents = filepoll(f, unused) & (fds[i].events | POLLHUP);
+        fileclose(f);
+      }
+      if(fds[i].revents)
+        ready++;
+    }
+    expired = timeout == 0 || (timeout > 0 && t.fired);
+    if(ready || expired || p->killed){
+      pollend();
+      break;
+    }
+    pollsleep();
+  }
+  if(timeout > 0)
+    timercancel(&t);
 
-  return filewrite(f, p, n);
+  if(p->killed || copyout(p->pagetable, ufds, (char*)fds, nfds*sizeof(fds[0])) < 0)
+    return -1;
+  return ready;
 }
 
 // رһļ
@@ -102,11 +368,21 @@ sys_close(void)
 {
   int fd;
   struct file *f;
+  struct proc *l = myproc()->leader;
 
   if(argfd(0, &fd, &f) < 0)
     return -1;
-  myproc()->ofile[fd] = 0;  // ɾļfdӦļָ
-  fileclose(f);
+  // another thread may be closing fd too.
+  acquire(&l->sharelock);
+  if(l->ofile[fd] != f){
+    release(&l->sharelock);
+    fileclose(f);
+    return -1;
+  }
+  l->ofile[fd] = 0;  // ɾļfdӦļָ
+  release(&l->sharelock);
+  fileclose(f);  // argfd()'s reference
+  fileclose(f);  // the table's
   return 0;
 }
 
@@ -116,10 +392,13 @@ sys_fstat(void)
 {
   struct file *f;
   uint64 st; // user pointer to struct stat
+  int r;
 
-  if(argfd(0, 0, &f) < 0 || argaddr(1, &st) < 0)
+  if(argaddr(1, &st) < 0 || argfd(0, 0, &f) < 0)
     return -1;
-  return filestat(f, st);
+  r = filestat(f, st);
+  fileclose(f);
+  return r;
 }
 
 // Create the path new as a link to the same inode as old.
@@ -296,17 +575,13 @@ create(char *path, short type, short major, short minor)
   return ip;  // ﷵصʱ򣬲ûͷipҲûмٴiallocӵü
 }
 
-uint64
-sys_open(void)
+// Open path with the given O_ mode and return a new file
+// with one reference, or 0 on failure.
+struct file*
+fileopen(char *path, int omode)
 {
-  char path[MAXPATH];
-  int fd, omode;
   struct file *f;
   struct inode *ip;
-  int n;
-
-  if((n = argstr(0, path, MAXPATH)) < 0 || argint(1, &omode) < 0)
-    return -1;
 
   begin_op();
 
@@ -314,34 +589,32 @@ sys_open(void)
     ip = create(path, T_FILE, 0, 0);
     if(ip == 0){
       end_op();
-      return -1;
+      return 0;
     }
   } else {  // ļѴ
     if((ip = namei(path)) == 0){
       end_op();
-      return -1;
+      return 0;
     }
     ilock(ip);
     if(ip->type == T_DIR && omode != O_RDONLY){  // 򿪵Ŀ¼ҴͲֻģͷش
       iunlockput(ip);
       end_op();
-      return -1;
+      return 0;
     }
   }
 
   if(ip->type == T_DEVICE && (ip->major < 0 || ip->major >= NDEV)){ // 򿪵豸ļ豸ǷЧ
     iunlockput(ip);
     end_op();
-    return -1;
+    return 0;
   }
 
-  if((f = filealloc()) == 0 || (fd = fdalloc(f)) < 0){  //һļṹһļ
+  if((f = filealloc()) == 0){  //һļṹһļ
   // fļϵͳеһλãfdǵǰдļбһļ
-    if(f)
-      fileclose(f);
     iunlockput(ip);
     end_op();
-    return -1;
+    return 0;
   }
 
   if(ip->type == T_DEVICE){  // inodeļ
@@ -357,6 +630,7 @@ sys_open(void)
   // Ϊ߻⣬ôͿͨO_WRONLYжϣomode & O_WRONLYΪ1֤ǿдģȡ0ôͲɶ
   // omode & O_WRONLYΪ0ôǲдضO_RDONLYO_RDWRеһǿɶġ
   f->writable = (omode & O_WRONLY) || (omode & O_RDWR);
+  f->nonblock = (omode & O_NONBLOCK) != 0;
 
   if((omode & O_TRUNC) && ip->type == T_FILE){  // ģʽO_TRUNCͨļôֱ
     itrunc(ip);
@@ -367,6 +641,24 @@ sys_open(void)
   // ģʽcreateͻnameiipʱipüûм٣û
   end_op();
 
+  return f;
+}
+
+uint64
+sys_open(void)
+{
+  char path[MAXPATH];
+  int fd, omode;
+  struct file *f;
+
+  if(argstr(0, path, MAXPATH) < 0 || argint(1, &omode) < 0)
+    return -1;
+  if((f = fileopen(path, omode)) == 0)
+    return -1;
+  if((fd = fdalloc(f)) < 0){
+    fileclose(f);
+    return -1;
+  }
   return fd;
 }
 
@@ -413,8 +705,8 @@ uint64
 sys_chdir(void)
 {
   char path[MAXPATH];
-  struct inode *ip;
-  struct proc *p = myproc();
+  struct inode *ip, *old;
+  struct proc *l = myproc()->leader;  // threads share its cwd
   
   begin_op();
   if(argstr(0, path, MAXPATH) < 0 || (ip = namei(path)) == 0){
@@ -428,9 +720,12 @@ sys_chdir(void)
     return -1;
   }
   iunlock(ip);
-  iput(p->cwd);  // ͷԭĹĿ¼inodeһü
+  acquire(&l->sharelock);
+  old = l->cwd;
+  l->cwd = ip;  //µĹĿ¼
+  release(&l->sharelock);
+  iput(old);  // ͷԭĹĿ¼inodeһü
   end_op();
-  p->cwd = ip;  //µĹĿ¼
   return 0;
 }
 
@@ -26,7 +26,7 @@ sys_exit(void)
 uint64
 sys_getpid(void)
 {
-  return myproc()->pid;
+  return myproc()->leader->pid;  // threads report their process's
 }
 
 uint64
@@ -52,31 +52,57 @@ sys_sbrk(void)
 
   if(argint(0, &n) < 0)
     return -1;
-  addr = myproc()->sz;
-  if(growproc(n) < 0)
+  if((addr = growproc(n)) < 0)
     return -1;
   return addr;
 }
 
+// clone(fn, arg, stack): start a thread; see clone() in proc.c.
+uint64
+sys_clone(void)
+{
+  uint64 fn, arg, stack;
+
+  if(argaddr(0, &fn) < 0 || argaddr(1, &arg) < 0 || argaddr(2, &stack) < 0)
+    return -1;
+  return clone(fn, arg, stack);
+}
+
+// join(tid, stack): wait for a thread to exit.
+uint64
+sys_join(void)
+{
+  int tid;
+  uint64 stack;
+
+  if(argint(0, &tid) < 0 || argaddr(1, &stack) < 0)
+    return -1;
+  return join(tid, stack);
+}
+
+// sleep(n): sleep until n more clock ticks have begun.
 uint64
 sys_sleep(void)
 {
   int n;
-  uint ticks0;
 
   if(argint(0, &n) < 0)
     return -1;
-  acquire(&tickslock);
-  ticks0 = ticks;
-  while(ticks - ticks0 < n){
-    if(myproc()->killed){
-      release(&tickslock);
-      return -1;
-    }
-    sleep(&ticks, &tickslock);
-  }
-  release(&tickslock);
-  return 0;
+  if(n <= 0)
+    return 0;
+  return sleepuntil((uint64)(uptime() + n) * TICKCYCLES);
+}
+
+// nanosleep(ns): sleep for ns nanoseconds, to within
+// a cycle of the time CSR rather than a clock tick.
+uint64
+sys_nanosleep(void)
+{
+  uint64 ns;
+
+  if(argaddr(0, &ns) < 0)
+    return -1;
+  return sleepuntil(r_time() + (ns + NSPERCYCLE - 1) / NSPERCYCLE);
 }
 
 uint64
@@ -89,15 +115,21 @@ sys_kill(void)
   return kill(pid);
 }
 
-// return how many clock tick interrupts have occurred
+// return how many clock ticks have passed
 // since start.
 uint64
 sys_uptime(void)
 {
-  uint xticks;
+  return uptime();
+}
 
-  acquire(&tickslock);
-  xticks = ticks;
-  release(&tickslock);
-  return xticks;
+// setpriority(pid, nice): see setpriority() in proc.c.
+uint64
+sys_setpriority(void)
+{
+  int pid, value;
+
+  if(argint(0, &pid) < 0 || argint(1, &value) < 0)
+    return -1;
+  return setpriority(pid, value);
 }
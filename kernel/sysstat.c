@@ -0,0 +1,77 @@
+//
+// System call statistics.
+// syscall() hands sysstatrec() the time each call took. Every
+// CPU has its own table, so recording needs no lock; sysstat()
+// adds the tables up. A process also counts its own calls and
+// their total time (see procsysstat()).
+//
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "defs.h"
+#include "sysstat.h"
+
+struct sysstat sysstats[NCPU][NSYSCALL];
+
+// Record that system call num of p took t cycles.
+void
+sysstatrec(struct proc *p, int num, uint64 t)
+{
+  struct sysstat *s;
+  int b;
+
+  for(b = 0; b < NSYSHIST-1 && (t >> (b+1)) != 0; b++)
+    ;
+  push_off();
+  s = &sysstats[cpuid()][num];
+  s->count++;
+  s->cycles += t;
+  if(t > s->max)
+    s->max = t;
+  s->hist[b]++;
+  pop_off();
+  p->nsys[num]++;
+  p->syscycles[num] += t;
+}
+
+// sysstat(pid, num, st): see sysstat.h.
+// The tables are read and cleared without stopping the
+// other CPUs, so a call that returns meanwhile may be
+// counted in some fields and not in others.
+uint64
+sys_sysstat(void)
+{
+  struct sysstat st;
+  uint64 addr;
+  int pid, num, i, b;
+
+  if(argint(0, &pid) < 0 || argint(1, &num) < 0 || argaddr(2, &addr) < 0)
+    return -1;
+  if(pid < 0){
+    memset(sysstats, 0, sizeof(sysstats));
+    return 0;
+  }
+  if(num < 0 || num >= NSYSCALL)
+    return -1;
+  memset(&st, 0, sizeof(st));
+  if(pid > 0){
+    if(procsysstat(pid, num, &st.count, &st.cycles) < 0)
+      return -1;
+  } else {
+    for(i = 0; i < NCPU; i++){
+      st.count += sysstats[i][num].count;
+      st.cycles += sysstats[i][num].cycles;
+      if(sysstats[i][num].max > st.max)
+        st.max = sysstats[i][num].max;
+      for(b = 0; b < NSYSHIST; b++)
+        st.hist[b] += sysstats[i][num].hist[b];
+    }
+  }
+  if(copyout(myproc()->pagetable, addr, (char*)&st, sizeof(st)) < 0)
+    return -1;
+  return 0;
+}
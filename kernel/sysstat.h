@@ -0,0 +1,17 @@
+// Per-system-call statistics (sysstat()). syscall() times every
+// call with the time CSR and counts it, system-wide and in the
+// calling process.
+
+#define NSYSHIST 32  // latency buckets
+
+// sysstat(pid, num, st) copies the statistics of system call num
+// to st: system-wide if pid is 0, else those of process pid,
+// which has only count and cycles. sysstat(-1, 0, 0) clears the
+// system-wide statistics.
+struct sysstat {
+  uint64 count;           // calls that returned
+  uint64 cycles;          // total time in them, in time CSR cycles
+  uint64 max;             // longest call
+  uint hist[NSYSHIST];    // hist[i]: calls of [2^i, 2^(i+1)) cycles; 0 and
+                          // 1 go in hist[0], longer ones in the last
+};
@@ -0,0 +1,294 @@
+//
+// Per-CPU timers.
+// Each CPU keeps its pending timers in a min-heap ordered by
+// deadline, and asks the CLINT for an interrupt at the earliest
+// one only; timervec in kernelvec.S disarms the CLINT and passes
+// the interrupt on to timerintr(). The scheduler's time-slice
+// tick is one of these timers, armed only while the CPU runs a
+// process, so an idle CPU stays in wfi until a timer it needs
+// comes due, a device interrupts, or kickidle() pokes it.
+// While the profiler runs, a second per-CPU timer samples
+// the CPU for prof.c.
+// Clock ticks are no longer counted; uptime() works them out
+// from the time CSR.
+//
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "defs.h"
+#include "timer.h"
+#include "stats.h"
+
+#define NTIMER (NPROC+2)  // one per process, the tick, and the profiling timer
+
+struct tq {
+  struct spinlock lock;
+  struct timer *heap[NTIMER];
+  int n;
+  struct timer tick;  // only this CPU arms and fires it
+  struct timer prof;  // likewise, while profiling
+  int idle;           // waiting in scheduler() for work
+  uint64 idlesince;   // when scheduler() began waiting, or 0
+  uint64 idlecycles;  // time spent waiting before that
+} tq[NCPU];
+
+static uint64 nextboost;  // when the next mlfqboost() is due
+
+void
+timerqinit(void)
+{
+  for(int i = 0; i < NCPU; i++){
+    initlock(&tq[i].lock, "timer");
+    tq[i].tick.idx = -1;
+    tq[i].prof.idx = -1;
+  }
+  nextboost = r_time() + BOOSTTICKS*TICKCYCLES;
+}
+
+// Clock ticks since boot, as returned by uptime().
+uint
+uptime(void)
+{
+  return r_time() / TICKCYCLES;
+}
+
+static void
+swap(struct tq *q, int i, int j)
+{
+  struct timer *t = q->heap[i];
+
+  q->heap[i] = q->heap[j];
+  q->heap[j] = t;
+  q->heap[i]->idx = i;
+  q->heap[j]->idx = j;
+}
+
+// Restore the heap order around slot i.
+static void
+fixheap(struct tq *q, int i)
+{
+  int m, l;
+
+  while(i > 0 && q->heap[(i-1)/2]->when > q->heap[i]->when){
+    swap(q, i, (i-1)/2);
+    i = (i-1)/2;
+  }
+  for(;;){
+    m = i;
+    l = 2*i + 1;
+    if(l < q->n && q->heap[l]->when < q->heap[m]->when)
+      m = l;
+    if(l+1 < q->n && q->heap[l+1]->when < q->heap[m]->when)
+      m = l+1;
+    if(m == i)
+      break;
+    swap(q, i, m);
+    i = m;
+  }
+}
+
+static void
+tqadd(struct tq *q, struct timer *t)
+{
+  if(q->n == NTIMER)
+    panic("tqadd");
+  t->idx = q->n;
+  q->heap[q->n++] = t;
+  fixheap(q, t->idx);
+}
+
+static void
+tqdel(struct tq *q, struct timer *t)
+{
+  int i = t->idx;
+
+  if(i != --q->n){
+    q->heap[i] = q->heap[q->n];
+    q->heap[i]->idx = i;
+    fixheap(q, i);
+  }
+  t->idx = -1;
+}
+
+// Ask the CLINT for an interrupt at this CPU's earliest
+// deadline, or none. Caller holds q->lock, q this CPU's queue.
+static void
+program(struct tq *q)
+{
+  *(uint64*)CLINT_MTIMECMP(q - tq) = q->n > 0 ? q->heap[0]->when : ~0ULL;
+}
+
+// Arm t to fire at time when, on this CPU.
+void
+timerset(struct timer *t, uint64 when)
+{
+  struct tq *q;
+
+  push_off();
+  q = &tq[cpuid()];
+  acquire(&q->lock);
+  t->when = when;
+  t->fired = 0;
+  t->q = q;
+  tqadd(q, t);
+  if(q->heap[0] == t)
+    program(q);
+  release(&q->lock);
+  pop_off();
+}
+
+// Disarm t, if it hasn't fired. It may be on another
+// CPU's queue, which then takes one needless interrupt.
+void
+timercancel(struct timer *t)
+{
+  struct tq *q = t->q;
+
+  acquire(&q->lock);
+  if(t->idx >= 0)
+    tqdel(q, t);
+  release(&q->lock);
+}
+
+// Sleep until time when. Returns -1 if killed first.
+int
+sleepuntil(uint64 when)
+{
+  struct proc *p = myproc();
+  struct timer t;
+  void *chan = &t;
+
+  timerset(&t, when);
+  for(;;){
+    pollstart(&chan, 1);
+    if(t.fired || p->killed){
+      pollend();
+      break;
+    }
+    pollsleep();
+  }
+  timercancel(&t);
+  return t.fired ? 0 : -1;
+}
+
+// scheduler() calls this before it runs a process, so the
+// process can be preempted when its time slice is up. Also
+// starts this CPU's profiling timer, if need be.
+void
+tickstart(void)
+{
+  struct tq *q = &tq[cpuid()];
+
+  if(q->tick.idx < 0)
+    timerset(&q->tick, r_time() + TICKCYCLES);
+  if(profiling && q->prof.idx < 0)
+    timerset(&q->prof, r_time() + profcycles);
+}
+
+// A timer interrupt: fire this CPU's expired timers. Returns 1
+// if the scheduler tick was one of them, so that the running
+// process should be charged for it.
+int
+timerintr(void)
+{
+  struct tq *q = &tq[cpuid()];
+  struct timer *t;
+  uint64 now, boost;
+  int tick, sample;
+
+  tick = sample = 0;
+  acquire(&q->lock);
+  now = r_time();
+  while(q->n > 0 && (t = q->heap[0])->when <= now){
+    tqdel(q, t);
+    t->fired = 1;
+    if(t == &q->tick){
+      tick = 1;
+      continue;
+    }
+    if(t == &q->prof){
+      sample = 1;
+      continue;
+    }
+    // t's owner may return and free it once woken, but
+    // wakeup() only compares the address.
+    release(&q->lock);
+    wakeup(t);
+    acquire(&q->lock);
+  }
+  // keep ticking only while there is a process to preempt.
+  if(tick && mycpu()->proc != 0){
+    q->tick.when += TICKCYCLES;
+    if(q->tick.when <= now)
+      q->tick.when = now + TICKCYCLES;
+    tqadd(q, &q->tick);
+  }
+  if(sample && profiling){
+    q->prof.when += profcycles;
+    if(q->prof.when <= now)
+      q->prof.when = now + profcycles;
+    tqadd(q, &q->prof);
+  }
+  program(q);
+  release(&q->lock);
+
+  if(sample)
+    profsample();
+
+  boost = nextboost;
+  if(tick && now >= boost &&
+     __sync_bool_compare_and_swap(&nextboost, boost, now + BOOSTTICKS*TICKCYCLES))
+    mlfqboost();
+  return tick;
+}
+
+// scheduler() calls setidle(1) before it looks for a process,
+// so that a kickidle() after it has looked isn't missed, and
+// setidle(0) once it has found one.
+void
+setidle(int idle)
+{
+  struct tq *q = &tq[cpuid()];
+
+  if(idle && q->idlesince == 0)
+    q->idlesince = r_time();
+  else if(!idle && q->idlesince){
+    q->idlecycles += r_time() - q->idlesince;
+    q->idlesince = 0;
+  }
+  q->idle = idle;
+  __sync_synchronize();
+}
+
+// A process has become runnable: interrupt an idle CPU, if
+// there is one, by setting its CLINT deadline in the past.
+void
+kickidle(void)
+{
+  __sync_synchronize();
+  for(int i = 0; i < NCPU; i++)
+    if(tq[i].idle && __sync_bool_compare_and_swap(&tq[i].idle, 1, 0)){
+      *(uint64*)CLINT_MTIMECMP(i) = 0;
+      return;
+    }
+}
+
+// Idle time of each CPU, counting the wait in progress.
+// Read without locks, so a CPU that stops waiting meanwhile
+// may be a little off.
+void
+timerstats(struct kstats *ks)
+{
+  uint64 since;
+
+  for(int i = 0; i < NCPU; i++){
+    since = tq[i].idlesince;
+    ks->idle[i] = tq[i].idlecycles;
+    if(since && ks->time > since)
+      ks->idle[i] += ks->time - since;
+  }
+}
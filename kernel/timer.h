@@ -0,0 +1,9 @@
+// A one-shot timer, armed by timerset() on the calling CPU.
+// When it fires, timerintr() sets fired and wakes up any
+// process sleeping or polling on the timer's address.
+struct timer {
+  uint64 when;     // deadline, in time CSR cycles
+  int fired;
+  int idx;         // slot in its CPU's heap, or -1
+  struct tq *q;    // the queue it was armed on
+};
@@ -5,9 +5,7 @@
 #include "spinlock.h"
 #include "proc.h"
 #include "defs.h"
-
-struct spinlock tickslock;
-uint ticks;
+#include "ktrace.h"
 
 extern char trampoline[], uservec[], userret[];
 
@@ -16,12 +14,6 @@ void kernelvec();
 
 extern int devintr();
 
-void
-trapinit(void)
-{
-  initlock(&tickslock, "time");
-}
-
 // set up to take exceptions and traps while in the kernel.
 void
 trapinithart(void)
@@ -69,6 +61,7 @@ usertrap(void)
   } else if((which_dev = devintr()) != 0){  //trap豸жϲ
     // ok
   } else {  // ж쳣ں˽ɱ
+    KTRACE(KT_FAULT, r_scause(), r_stval());
     printf("usertrap(): unexpected scause %p pid=%d\n", r_scause(), p->pid);
     printf("            sepc=%p stval=%p\n", r_sepc(), r_stval());
     p->killed = 1;
@@ -78,7 +71,7 @@ usertrap(void)
     exit(-1);
 
   // give up the CPU if this is a timer interrupt.
-  if(which_dev == 2)
+  if(which_dev == 2 && schedtick())
     yield();
 
   usertrapret();
@@ -108,6 +101,10 @@ usertrapret(void)
   p->trapframe->kernel_trap = (uint64)usertrap;   //طҪuservecõǶûǴuservecģʼʱطôõأ
   p->trapframe->kernel_hartid = r_tp();         // hartid for cpuid()
 
+  // refresh the clock in the USYSCALL page.
+  p->usyscall->ticks = uptime();
+  p->usyscall->tickstamp = (uint64)p->usyscall->ticks * TICKCYCLES;
+
   // set up the registers that trampoline.S's sret will use
   // to get to user space.
   
@@ -127,7 +124,7 @@ usertrapret(void)
   // switches to the user page table, restores user registers,
   // and switches to user mode with sret.
   uint64 fn = TRAMPOLINE + (userret - trampoline);  // תtrampolineеuserret
-  ((void (*)(uint64,uint64))fn)(TRAPFRAME, satp);  //satpΪڶa1Ĵ
+  ((void (*)(uint64,uint64))fn)(p->tfva, satp);  //satpΪڶa1Ĵ
 }
 
 // interrupts and exceptions from kernel code go here via kernelvec,
@@ -152,7 +149,7 @@ kerneltrap()
   }
 
   // give up the CPU if this is a timer interrupt.
-  if(which_dev == 2 && myproc() != 0 && myproc()->state == RUNNING)
+  if(which_dev == 2 && myproc() != 0 && myproc()->state == RUNNING && schedtick())
     yield();
 
   // the yield() may have caused some traps to occur,
@@ -161,19 +158,10 @@ kerneltrap()
   w_sstatus(sstatus);
 }
 
-void
-clockintr()
-{
-  acquire(&tickslock);
-  ticks++;
-  wakeup(&ticks);
-  release(&tickslock);
-}
-
 // check if it's an external interrupt or software interrupt,
 // and handle it.
-// returns 2 if timer interrupt,
-// 1 if other device,
+// returns 2 if the scheduler tick,
+// 1 if other device or timer,
 // 0 if not recognized.
 int
 devintr()
@@ -207,15 +195,12 @@ devintr()
     // software interrupt from a machine-mode timer interrupt,
     // forwarded by timervec in kernelvec.S.
 
-    if(cpuid() == 0){
-      clockintr();
-    }
-    
     // acknowledge the software interrupt by clearing
-    // the SSIP bit in sip.
+    // the SSIP bit in sip, before timerintr() programs
+    // the next one.
     w_sip(r_sip() & ~2);
 
-    return 2;
+    return timerintr() ? 2 : 1;
   } else {
     return 0;
   }
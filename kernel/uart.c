@@ -38,16 +38,18 @@
 #define ReadReg(reg) (*(Reg(reg)))
 #define WriteReg(reg, v) (*(Reg(reg)) = (v))
 
-// the transmit output buffer.
+// the transmit output buffer. printf() takes this lock too,
+// so code holding it must not print.
 struct spinlock uart_tx_lock;
-#define UART_TX_BUF_SIZE 32
-char uart_tx_buf[UART_TX_BUF_SIZE];  // UARTĻλݴҪ첽ԵĻϵַ
-int uart_tx_w; // write next to uart_tx_buf[uart_tx_w++]
-int uart_tx_r; // read next from uart_tx_buf[uar_tx_r++]
+#define UART_TX_BUF_SIZE 1024  // a power of two
+#define UART_FIFO 16           // bytes the 16550 transmit FIFO holds
+char uart_tx_buf[UART_TX_BUF_SIZE];  // UARTĻλݴҪ첽ʾĻϵַ
+uint uart_tx_w; // write next to uart_tx_buf[uart_tx_w++ % UART_TX_BUF_SIZE]
+uint uart_tx_r; // read next from uart_tx_buf[uart_tx_r++ % UART_TX_BUF_SIZE]
 
 extern volatile int panicked; // from printf.c
 
-void uartstart();
+int uartstart();
 
 void
 uartinit(void)
@@ -75,18 +77,34 @@ uartinit(void)
   // enable transmit and receive interrupts.
   WriteReg(IER, IER_TX_ENABLE | IER_RX_ENABLE);  // ʹжϣuartCPUж
 
-  initlock(&uart_tx_lock, "uart");   // ʼоƬ16550ʱһСΪ32Ļλuart_tx_bufUARTҪ͵
+  initlock(&uart_tx_lock, "uart");   // ʼоƬ16550λuart_tx_bufUARTҪ͵
 }
 
-// add a character to the output buffer and tell the
-// UART to start sending if it isn't already.
-// blocks if the output buffer is full.
-// because it may block, it can't be called
-// from interrupts; it's only suitable for use
-// by write().
-void
-uartputc(int c)   // ַc洢uart_tx_bufȻ첽ʾuart_tx_bufݵĻ
+// copy n bytes of buf into the output buffer, which has
+// room for them. caller must hold uart_tx_lock.
+static void
+uartcopy(char *buf, int n)
 {
+  uint off = uart_tx_w % UART_TX_BUF_SIZE;
+  int m = UART_TX_BUF_SIZE - off;
+
+  if(m > n)
+    m = n;
+  memmove(uart_tx_buf + off, buf, m);
+  memmove(uart_tx_buf, buf + m, n - m);
+  uart_tx_w += n;
+}
+
+// add up to n bytes of buf to the output buffer and tell
+// the UART to start sending if it isn't already; returns
+// how many were taken. blocks while the buffer is full.
+// because it may block, it can't be called from
+// interrupts; it's only suitable for use by write().
+int
+uartwrite(char *buf, int n)
+{
+  int m;
+
   acquire(&uart_tx_lock);
 
   if(panicked){  // ں˷ϣֱѭʧȥӦ
@@ -94,71 +112,138 @@ uartputc(int c)   // 
       ;
   }
 
-  while(1){
-    if(((uart_tx_w + 1) % UART_TX_BUF_SIZE) == uart_tx_r){
-      // buffer is full.
-      // wait for uartstart() to open up space in the buffer.
-      sleep(&uart_tx_r, &uart_tx_lock);
-    } else {
-      uart_tx_buf[uart_tx_w] = c;
-      uart_tx_w = (uart_tx_w + 1) % UART_TX_BUF_SIZE;   // uart_tx_bufɻ
-      uartstart();  // 첽ʾ
-      release(&uart_tx_lock);
-      return;
+  while(uart_tx_w - uart_tx_r == UART_TX_BUF_SIZE){
+    // buffer is full.
+    // wait for uartstart() to open up space in the buffer.
+    sleep(&uart_tx_r, &uart_tx_lock);
+  }
+  m = UART_TX_BUF_SIZE - (uart_tx_w - uart_tx_r);
+  if(m > n)
+    m = n;
+  uartcopy(buf, m);
+  if(uartstart())  // 첽ʾ
+    wakeup(&uart_tx_r);  // other writers may be waiting for space
+  release(&uart_tx_lock);
+  return m;
+}
+
+// add n bytes to the output buffer without sleeping, to
+// echo characters; usable from interrupts. only if the
+// buffer is full does it wait, for the UART to take the
+// bytes in front.
+void
+uartputs(char *buf, int n)
+{
+  int m;
+
+  acquire(&uart_tx_lock);
+
+  if(panicked){
+    for(;;)
+      ;
+  }
+
+  while(n > 0){
+    while(uart_tx_w - uart_tx_r == UART_TX_BUF_SIZE){
+      while((ReadReg(LSR) & LSR_TX_IDLE) == 0)
+        ;
+      uartstart();
     }
+    m = UART_TX_BUF_SIZE - (uart_tx_w - uart_tx_r);
+    if(m > n)
+      m = n;
+    uartcopy(buf, m);
+    buf += m;
+    n -= m;
   }
+  uartstart();
+  release(&uart_tx_lock);
 }
 
-// alternate version of uartputc() that doesn't 
-// use interrupts, for use by kernel printf() and
-// to echo characters. it spins waiting for the uart's
-// output register to be empty.
+// start sending the kernel log, for printf(), which can't
+// wake anyone. the UART interrupt sends the rest. takes
+// uart_tx_lock, which the caller must not hold.
 void
-uartputc_sync(int c)
+uartkick(void)
 {
-  push_off();
+  acquire(&uart_tx_lock);
+  uartstart();
+  release(&uart_tx_lock);
+}
+
+// wait for the UART to finish its last burst, and start the
+// next; for a CPU whose kernel log ring is full of text not
+// yet sent.
+void
+uartpoll(void)
+{
+  acquire(&uart_tx_lock);
 
   if(panicked){
     for(;;)
       ;
   }
 
-  // wait for Transmit Holding Empty to be set in LSR.
   while((ReadReg(LSR) & LSR_TX_IDLE) == 0)
     ;
-  WriteReg(THR, c);
+  uartstart();
+  release(&uart_tx_lock);
+}
+
+// send the unsent kernel log, everything in the output
+// buffer, and then n bytes of buf, spinning on the UART,
+// without locks or interrupts. only for the CPU that
+// panicked; the others stop at their next output.
+void
+uartflush(char *buf, int n)
+{
+  char c;
+  int i;
 
-  pop_off();
+  while(klogtake(&c, 1) == 1){
+    while((ReadReg(LSR) & LSR_TX_IDLE) == 0)
+      ;
+    WriteReg(THR, c);
+  }
+  while(uart_tx_r != uart_tx_w){
+    while((ReadReg(LSR) & LSR_TX_IDLE) == 0)
+      ;
+    WriteReg(THR, uart_tx_buf[uart_tx_r++ % UART_TX_BUF_SIZE]);
+  }
+  for(i = 0; i < n; i++){
+    while((ReadReg(LSR) & LSR_TX_IDLE) == 0)
+      ;
+    WriteReg(THR, buf[i]);
+  }
 }
 
-// if the UART is idle, and a character is waiting
-// in the transmit buffer, send it.
+// if the UART's transmit FIFO is empty, fill it with kernel
+// log text not yet sent, then characters waiting in the
+// transmit buffer; returns how many of the latter. the UART
+// interrupts once it has sent them all. it doesn't wake
+// writers waiting for space, since printf() may call it
+// holding any lock; callers do.
 // caller must hold uart_tx_lock.
 // called from both the top- and bottom-half.
-void
+int
 uartstart()  // uartbufжȡݣȻдTHRĴֱUARTоƬݵĺ
-{            // һεuartstartÿεǰuart_tx_bufֹͬʱTHRĴдֵ
-  while(1){
-    if(uart_tx_w == uart_tx_r){
-      // transmit buffer is empty.
-      return;
-    }
-    
-    if((ReadReg(LSR) & LSR_TX_IDLE) == 0){  // ΪգUARTûһηͣʱֱӷ
-      // the UART transmit holding register is full,
-      // so we cannot give it another byte.
-      // it will interrupt when it's ready for a new byte.
-      return;
-    }
-    
-    int c = uart_tx_buf[uart_tx_r];
-    uart_tx_r = (uart_tx_r + 1) % UART_TX_BUF_SIZE;
-    
-    // maybe uartputc() is waiting for space in the buffer.
-    wakeup(&uart_tx_r);  // uartputc򻺳ûжĿռ˯ߵļuart_tx_rϵ
-    
-    WriteReg(THR, c);  // THRĴᱻUARTԶз
+{            // ÿεuartstartǰuart_tx_bufֹͬʱTHRĴдֵ
+  char burst[UART_FIFO];
+  int i, n;
+
+  if((ReadReg(LSR) & LSR_TX_IDLE) == 0){  // ΪգUARTûһηͣʱֱӷ
+    // the UART is still sending the last burst.
+    // it will interrupt when it's ready for more.
+    return 0;
   }
+
+  // THR empty means the whole FIFO is.
+  n = klogtake(burst, UART_FIFO);
+  for(i = 0; i < n; i++)
+    WriteReg(THR, burst[i]);
+  for(i = 0; n < UART_FIFO && uart_tx_r != uart_tx_w; i++, n++)
+    WriteReg(THR, uart_tx_buf[uart_tx_r++ % UART_TX_BUF_SIZE]);  // THRĴᱻUARTԶз
+  return i;
 }
 
 // read one input character from the UART.
@@ -190,6 +275,8 @@ uartintr(void)
 
   // send buffered characters.
   acquire(&uart_tx_lock);
-  uartstart();  // Ļuart_tx_bufд͵
+  if(uartstart())  // Ļuart_tx_bufд͵
+    wakeup(&uart_tx_r);  // uartwrite() may be waiting for space
+
   release(&uart_tx_lock);
 }
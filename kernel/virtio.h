@@ -45,7 +45,11 @@
 
 // this many virtio descriptors.
 // must be a power of two.
-#define NUM 8
+#define NUM 32
+
+// most bufs merged into one block request.
+// a request uses this many data descriptors plus two.
+#define MAXMERGE 8
 
 struct VRingDesc {
   uint64 addr;
@@ -65,6 +69,13 @@ struct VRingUsedElem {
 #define VIRTIO_BLK_T_IN  0 // read the disk
 #define VIRTIO_BLK_T_OUT 1 // write the disk
 
+// the first descriptor of a block request points to one of these.
+struct virtio_blk_outhdr {
+  uint32 type;
+  uint32 reserved;
+  uint64 sector;
+};
+
 struct UsedArea {
   uint16 flags;
   uint16 id;
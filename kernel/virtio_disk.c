@@ -16,6 +16,8 @@
 #include "fs.h"
 #include "buf.h"
 #include "virtio.h"
+#include "ktrace.h"
+#include "stats.h"
 
 // the address of virtio mmio register r.
 #define R(r) ((volatile uint32 *)(VIRTIO0 + (r)))
@@ -37,10 +39,24 @@ static struct disk {
   // track info about in-flight operations,
   // for use when completion interrupt arrives.
   // indexed by first descriptor index of chain.
+  // b is the first of the request's bufs, linked through qnext.
   struct {
     struct buf *b;
     char status;
   } info[NUM];
+
+  // bufs waiting for descriptors, sorted by qblock.
+  struct buf *queue;
+  uint headpos;    // block after the last one dispatched
+
+  // statistics.
+  uint64 nreq;     // requests given to the device
+  uint64 nbuf;     // bufs transferred by those requests
+
+  // request headers, indexed by first descriptor index of chain.
+  // they live here rather than on a kernel stack so that a batch
+  // of requests can be outstanding at once.
+  struct virtio_blk_outhdr ops[NUM];
   
   struct spinlock vdisk_lock;
   
@@ -151,10 +167,11 @@ free_chain(int i)
   }
 }
 
+// allocate n descriptors, all or none.
 static int
-alloc3_desc(int *idx)
+alloc_descs(int *idx, int n)
 {
-  for(int i = 0; i < 3; i++){
+  for(int i = 0; i < n; i++){
     idx[i] = alloc_desc();
     if(idx[i] < 0){
       for(int j = 0; j < i; j++)
@@ -165,66 +182,51 @@ alloc3_desc(int *idx)
   return 0;
 }
 
-void
-virtio_disk_rw(struct buf *b, int write)
+// Give the device one request covering the n bufs linked
+// from b through qnext, whose qblocks are consecutive.
+static void
+virtio_disk_start(struct buf *b, int n, int *idx)
 {
-  uint64 sector = b->blockno * (BSIZE / 512);
-
-  acquire(&disk.vdisk_lock);
+  struct buf *x;
+  int i;
 
-  // the spec says that legacy block operations use three
-  // descriptors: one for type/reserved/sector, one for
-  // the data, one for a 1-byte status result.
-
-  // allocate the three descriptors.
-  int idx[3];
-  while(1){
-    if(alloc3_desc(idx) == 0) {
-      break;
-    }
-    sleep(&disk.free[0], &disk.vdisk_lock);
-  }
-  
-  // format the three descriptors.
+  // a legacy block request is a descriptor for
+  // type/reserved/sector, one descriptor per data buffer,
+  // and one for a 1-byte status result.
   // qemu's virtio-blk.c reads them.
 
-  struct virtio_blk_outhdr {
-    uint32 type;
-    uint32 reserved;
-    uint64 sector;
-  } buf0;
+  struct virtio_blk_outhdr *buf0 = &disk.ops[idx[0]];
 
-  if(write)
-    buf0.type = VIRTIO_BLK_T_OUT; // write the disk
+  if(b->qwrite)
+    buf0->type = VIRTIO_BLK_T_OUT; // write the disk
   else
-    buf0.type = VIRTIO_BLK_T_IN; // read the disk
-  buf0.reserved = 0;
-  buf0.sector = sector;
-
-  // buf0 is on a kernel stack, which is not direct mapped,
-  // thus the call to kvmpa().
-  disk.desc[idx[0]].addr = (uint64) kvmpa((uint64) &buf0);
-  disk.desc[idx[0]].len = sizeof(buf0);
+    buf0->type = VIRTIO_BLK_T_IN; // read the disk
+  buf0->reserved = 0;
+  buf0->sector = (uint64)b->qblock * (BSIZE / 512);
+
+  disk.desc[idx[0]].addr = (uint64) buf0;
+  disk.desc[idx[0]].len = sizeof(*buf0);
   disk.desc[idx[0]].flags = VRING_DESC_F_NEXT;
   disk.desc[idx[0]].next = idx[1];
 
-  disk.desc[idx[1]].addr = (uint64) b->data;
-  disk.desc[idx[1]].len = BSIZE;
-  if(write)
-    disk.desc[idx[1]].flags = 0; // device reads b->data
-  else
-    disk.desc[idx[1]].flags = VRING_DESC_F_WRITE; // device writes b->data
-  disk.desc[idx[1]].flags |= VRING_DESC_F_NEXT;
-  disk.desc[idx[1]].next = idx[2];
+  for(i = 1, x = b; i <= n; i++, x = x->qnext){
+    disk.desc[idx[i]].addr = (uint64) x->data;
+    disk.desc[idx[i]].len = BSIZE;
+    if(b->qwrite)
+      disk.desc[idx[i]].flags = 0; // device reads x->data
+    else
+      disk.desc[idx[i]].flags = VRING_DESC_F_WRITE; // device writes x->data
+    disk.desc[idx[i]].flags |= VRING_DESC_F_NEXT;
+    disk.desc[idx[i]].next = idx[i+1];
+  }
 
   disk.info[idx[0]].status = 0;
-  disk.desc[idx[2]].addr = (uint64) &disk.info[idx[0]].status;
-  disk.desc[idx[2]].len = 1;
-  disk.desc[idx[2]].flags = VRING_DESC_F_WRITE; // device writes the status
-  disk.desc[idx[2]].next = 0;
+  disk.desc[idx[n+1]].addr = (uint64) &disk.info[idx[0]].status;
+  disk.desc[idx[n+1]].len = 1;
+  disk.desc[idx[n+1]].flags = VRING_DESC_F_WRITE; // device writes the status
+  disk.desc[idx[n+1]].next = 0;
 
-  // record struct buf for virtio_disk_intr().
-  b->disk = 1;
+  // record the bufs for virtio_disk_intr().
   disk.info[idx[0]].b = b;
 
   // avail[0] is flags
@@ -237,20 +239,115 @@ virtio_disk_rw(struct buf *b, int write)
 
   *R(VIRTIO_MMIO_QUEUE_NOTIFY) = 0; // value is queue number
 
-  // Wait for virtio_disk_intr() to say request has finished.
-  while(b->disk == 1) {
-    sleep(b, &disk.vdisk_lock);
+  disk.nreq++;
+  disk.nbuf += n;
+  KTRACE(KT_DISKSUB, b->qblock, n*2 + b->qwrite);
+}
+
+// Add b to the pending queue, keeping it sorted by block.
+static void
+enqueue(struct buf *b)
+{
+  struct buf **pp;
+
+  for(pp = &disk.queue; *pp && (*pp)->qblock <= b->qblock; pp = &(*pp)->qnext)
+    ;
+  b->qnext = *pp;
+  *pp = b;
+}
+
+// Start queued bufs while descriptors last. Requests go out in
+// one-way elevator order: the lowest block at or after the last
+// one dispatched, wrapping to the lowest block overall. A run of
+// queued bufs with consecutive blocks and the same direction is
+// merged into a single request.
+// Caller holds disk.vdisk_lock.
+static void
+dispatch(void)
+{
+  struct buf **pp, *b, *last;
+  int n, idx[MAXMERGE+2];
+
+  while(disk.queue){
+    for(pp = &disk.queue; *pp && (*pp)->qblock < disk.headpos; pp = &(*pp)->qnext)
+      ;
+    if(*pp == 0)
+      pp = &disk.queue;
+    b = *pp;
+    n = 1;
+    for(last = b; n < MAXMERGE && last->qnext &&
+        last->qnext->qblock == last->qblock + 1 &&
+        last->qnext->qwrite == b->qwrite; last = last->qnext)
+      n++;
+    if(alloc_descs(idx, n+2) < 0)
+      return;  // virtio_disk_intr() will call again
+    *pp = last->qnext;
+    last->qnext = 0;
+    disk.headpos = last->qblock + 1;
+    virtio_disk_start(b, n, idx);
+  }
+}
+
+// Read or write n bufs, bs[i] at disk block blocknos[i].
+// The bufs join the pending queue together, so the whole batch
+// can be sorted and merged before the device sees it.
+void
+virtio_disk_rwv(struct buf **bs, uint *blocknos, int n, int write)
+{
+  int i;
+
+  acquire(&disk.vdisk_lock);
+
+  for(i = 0; i < n; i++){
+    bs[i]->qblock = blocknos[i];
+    bs[i]->qwrite = write;
+    bs[i]->disk = 1;
+    enqueue(bs[i]);
   }
+  dispatch();
 
-  disk.info[idx[0]].b = 0;
-  free_chain(idx[0]);
+  // Wait for virtio_disk_intr() to say the requests have finished.
+  for(i = 0; i < n; i++){
+    while(bs[i]->disk == 1) {
+      sleep(bs[i], &disk.vdisk_lock);
+    }
+  }
 
   release(&disk.vdisk_lock);
 }
 
+void
+virtio_disk_rw(struct buf *b, int write)
+{
+  uint blockno = b->blockno;
+
+  virtio_disk_rwv(&b, &blockno, 1, write);
+}
+
+void
+virtio_disk_stats(struct kstats *ks)
+{
+  acquire(&disk.vdisk_lock);
+  ks->nreq = disk.nreq;
+  ks->nblock = disk.nbuf;
+  release(&disk.vdisk_lock);
+}
+
+// Print request statistics to the console (on ^P).
+void
+virtio_disk_dump(void)
+{
+  uint64 nreq = disk.nreq, nbuf = disk.nbuf;
+
+  printf("disk: %l requests, %l blocks, %l merged, %l bytes/request\n",
+         nreq, nbuf, nbuf - nreq, nreq ? nbuf * BSIZE / nreq : 0);
+}
+
 void
 virtio_disk_intr()
 {
+  struct buf *b, *next;
+
   acquire(&disk.vdisk_lock);
 
   while((disk.used_idx % NUM) != (disk.used->id % NUM)){
@@ -258,13 +355,24 @@ virtio_disk_intr()
 
     if(disk.info[id].status != 0)
       panic("virtio_disk_intr status");
+    KTRACE(KT_DISKDONE, disk.info[id].b->qblock, 0);
     
-    disk.info[id].b->disk = 0;   // disk is done with buf
-    wakeup(disk.info[id].b);
+    for(b = disk.info[id].b; b; b = next){
+      next = b->qnext;
+      b->disk = 0;   // disk is done with buf
+      wakeup(b);
+    }
+
+    // free the chain here so that dispatch() can start
+    // requests still waiting in the queue.
+    disk.info[id].b = 0;
+    free_chain(id);
 
     disk.used_idx = (disk.used_idx + 1) % NUM;
   }
   *R(VIRTIO_MMIO_INTERRUPT_ACK) = *R(VIRTIO_MMIO_INTERRUPT_STATUS) & 0x3;
 
+  dispatch();
+
   release(&disk.vdisk_lock);
 }
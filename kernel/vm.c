@@ -81,7 +81,7 @@ walk(pagetable_t pagetable, uint64 va, int alloc)  //walk
     } else {  //proc_pagetableڸշpagetableʹmappagesַַӳʱwalkԶķһҳҳ֮ǰϵ
       if(!alloc || (pagetable = (pde_t*)kalloc()) == 0)
         return 0;
-      memset(pagetable, 0, PGSIZE);
+      zero_page(pagetable);
       *pte = PA2PTE(pagetable) | PTE_V;
     }
   }
@@ -203,7 +203,7 @@ uvmcreate()   //
   pagetable = (pagetable_t) kalloc();
   if(pagetable == 0)
     return 0;
-  memset(pagetable, 0, PGSIZE);
+  zero_page(pagetable);
   return pagetable;
 }
 
@@ -241,7 +241,7 @@ uvmalloc(pagetable_t pagetable, uint64 oldsz, uint64 newsz)  // 
       uvmdealloc(pagetable, a, oldsz);
       return 0;
     }
-    memset(mem, 0, PGSIZE);
+    zero_page(mem);
     if(mappages(pagetable, a, PGSIZE, (uint64)mem, PTE_W|PTE_X|PTE_R|PTE_U) != 0){
       kfree(mem);
       uvmdealloc(pagetable, a, oldsz);
@@ -322,7 +322,7 @@ uvmcopy(pagetable_t old, pagetable_t new, uint64 sz)  //ֻ
     flags = PTE_FLAGS(*pte);
     if((mem = kalloc()) == 0)
       goto err;
-    memmove(mem, (char*)pa, PGSIZE);
+    copy_page(mem, (char*)pa);
     if(mappages(new, i, PGSIZE, (uint64)mem, flags) != 0){  // Ϊӽ̵ҳӳϵ
       kfree(mem);
       goto err;
@@ -40,6 +40,7 @@ void rinode(uint inum, struct dinode *ip);
 void rsect(uint sec, void *buf);
 uint ialloc(ushort type);
 void iappend(uint inum, void *p, int n);
+void rootdir(uint rootino, struct dirent *ents, int n);
 
 // convert to intel byte order
 ushort
@@ -67,11 +68,10 @@ xint(uint x)
 int
 main(int argc, char *argv[])
 {
-  int i, cc, fd;
-  uint rootino, inum, off;
-  struct dirent de;
+  int i, cc, fd, nents;
+  uint rootino, inum;
+  struct dirent ents[NINODES];
   char buf[BSIZE];
-  struct dinode din;
 
 
   static_assert(sizeof(int) == 4, "Integers must be 4 bytes!");
@@ -118,15 +118,8 @@ main(int argc, char *argv[])
   rootino = ialloc(T_DIR);
   assert(rootino == ROOTINO);
 
-  bzero(&de, sizeof(de));
-  de.inum = xshort(rootino);
-  strcpy(de.name, ".");
-  iappend(rootino, &de, sizeof(de));
-
-  bzero(&de, sizeof(de));
-  de.inum = xshort(rootino);
-  strcpy(de.name, "..");
-  iappend(rootino, &de, sizeof(de));
+  bzero(ents, sizeof(ents));
+  nents = 0;
 
   for(i = 2; i < argc; i++){
     // get rid of "user/"
@@ -152,10 +145,9 @@ main(int argc, char *argv[])
 
     inum = ialloc(T_FILE);
 
-    bzero(&de, sizeof(de));
-    de.inum = xshort(inum);
-    strncpy(de.name, shortname, DIRSIZ);
-    iappend(rootino, &de, sizeof(de));
+    ents[nents].inum = xshort(inum);
+    strncpy(ents[nents].name, shortname, DIRSIZ);
+    nents++;
 
     while((cc = read(fd, buf, sizeof(buf))) > 0)
       iappend(inum, buf, cc);
@@ -163,12 +155,7 @@ main(int argc, char *argv[])
     close(fd);
   }
 
-  // fix size of root inode dir
-  rinode(rootino, &din);
-  off = xint(din.size);
-  off = ((off/BSIZE) + 1) * BSIZE;
-  din.size = xint(off);
-  winode(rootino, &din);
+  rootdir(rootino, ents, nents);
 
   balloc(freeblock);
 
@@ -258,6 +245,79 @@ balloc(int used)
   wsect(sb.bmapstart, buf);
 }
 
+// Must match dirhash() in kernel/fs.c.
+uint
+dirhash(char *name)
+{
+  uint h;
+  int i;
+
+  h = 2166136261U;
+  for(i = 0; i < DIRSIZ && name[i]; i++){
+    h ^= (uchar)name[i];
+    h *= 16777619U;
+  }
+  return h;
+}
+
+int
+hashcmp(const void *a, const void *b)
+{
+  uint ha = dirhash(((struct dirent*)a)->name);
+  uint hb = dirhash(((struct dirent*)b)->name);
+
+  return ha < hb ? -1 : ha > hb;
+}
+
+// Write the root directory as an indexed directory: block 0 holds
+// ".", ".." and the hash index, the entries go into leaf blocks
+// sorted by hash.  Leaves are filled only halfway so the kernel
+// can add names without splitting right away.
+void
+rootdir(uint rootino, struct dirent *ents, int n)
+{
+  struct dxroot root;
+  struct dirent leaf[DPB];
+  int i, nent, first[NDXENTRY+1];
+  uint h;
+
+  qsort(ents, n, sizeof(struct dirent), hashcmp);
+
+  bzero(&root, sizeof(root));
+  root.dot.inum = xshort(rootino);
+  strcpy(root.dot.name, ".");
+  root.dotdot.inum = xshort(rootino);
+  strcpy(root.dotdot.name, "..");
+  root.magic = xint(DXMAGIC);
+
+  // Assign entries to leaves, never splitting equal hashes.
+  nent = 0;
+  first[0] = 0;
+  for(i = 0; i < n; i++){
+    h = dirhash(ents[i].name);
+    if(i == 0 || (i - first[nent-1] >= DPB/2 && h != dirhash(ents[i-1].name))){
+      assert(nent < NDXENTRY);
+      root.ent[nent].hash = xint(nent == 0 ? 0 : h);
+      root.ent[nent].block = xint(nent + 1);
+      first[nent++] = i;
+    }
+    assert(i - first[nent-1] < DPB);
+  }
+  if(nent == 0){
+    root.ent[0].block = xint(1);
+    nent = 1;
+  }
+  first[nent] = n;
+  root.nent = xshort(nent);
+  iappend(rootino, &root, sizeof(root));
+
+  for(i = 0; i < nent; i++){
+    bzero(leaf, sizeof(leaf));
+    memmove(leaf, ents + first[i], (first[i+1] - first[i]) * sizeof(struct dirent));
+    iappend(rootino, leaf, sizeof(leaf));
+  }
+}
+
 #define min(a, b) ((a) < (b) ? (a) : (b))
 
 void
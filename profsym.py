@@ -0,0 +1,95 @@
+#!/usr/bin/env python3
+#
+# Turn the samples printed by xv6's prof command into a flat
+# profile. Save the console output of a run, e.g.
+#
+#   $ make qemu | tee prof.log
+#   $ prof -i 500 grind
+#
+# then on the host:
+#
+#   $ ./profsym.py prof.log
+#
+# Kernel samples are looked up in kernel/kernel, and user
+# samples in user/_<name>, with nm from the riscv toolchain.
+
+import argparse
+import bisect
+import collections
+import re
+import shutil
+import subprocess
+import sys
+
+SAMPLE = re.compile(r'prof: (\d+) (\d+) (\S+) ([ku]) (0x[0-9a-fA-F]+)')
+NMS = ['riscv64-unknown-elf-nm', 'riscv64-linux-gnu-nm',
+       'riscv64-unknown-linux-gnu-nm', 'nm']
+
+
+class Symbols:
+    def __init__(self, nm, path):
+        self.addrs, self.names = [], []
+        try:
+            out = subprocess.run([nm, '-n', path], capture_output=True,
+                                 text=True, check=True).stdout
+        except (OSError, subprocess.CalledProcessError):
+            return
+        for line in out.splitlines():
+            f = line.split()
+            if len(f) == 3 and f[1] in 'tTwW':
+                self.addrs.append(int(f[0], 16))
+                self.names.append(f[2])
+
+    def lookup(self, pc):
+        i = bisect.bisect_right(self.addrs, pc) - 1
+        if i < 0:
+            return '0x%x' % pc
+        return self.names[i]
+
+
+def main():
+    ap = argparse.ArgumentParser(description='flat profile from prof samples')
+    ap.add_argument('log', nargs='?', default='-', help='console output (default stdin)')
+    ap.add_argument('--nm', default=None, help='nm to use')
+    ap.add_argument('--kernel', default='kernel/kernel')
+    ap.add_argument('--user', default='user', help='directory with the _<name> binaries')
+    ap.add_argument('--skip', action='append', default=['prof'],
+                    help='ignore samples of processes with this name (default: prof)')
+    ap.add_argument('-n', type=int, default=40, help='rows to print')
+    args = ap.parse_args()
+
+    nm = args.nm or next((n for n in NMS if shutil.which(n)), None)
+    if nm is None:
+        sys.exit('profsym: no nm found; use --nm')
+
+    f = sys.stdin if args.log == '-' else open(args.log, errors='replace')
+    tables = {}
+    counts = collections.Counter()
+    total = 0
+    for line in f:
+        m = SAMPLE.search(line)
+        if m is None:
+            continue
+        _, pid, name, mode, pc = m.groups()
+        if name in args.skip:
+            continue
+        total += 1
+        if name == 'idle':
+            counts[('idle', '(idle)')] += 1
+            continue
+        binary = args.kernel if mode == 'k' else '%s/_%s' % (args.user, name)
+        if binary not in tables:
+            tables[binary] = Symbols(nm, binary)
+        where = 'kernel' if mode == 'k' else name
+        counts[(where, tables[binary].lookup(int(pc, 16)))] += 1
+
+    if total == 0:
+        sys.exit('profsym: no samples')
+    print('%8s %6s  %-10s %s' % ('samples', '%', 'where', 'function'))
+    for (where, fn), n in counts.most_common(args.n):
+        print('%8d %6.2f  %-10s %s' % (n, 100.0 * n / total, where, fn))
+    print('%8d total' % total)
+
+
+if __name__ == '__main__':
+    main()
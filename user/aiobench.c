@@ -0,0 +1,113 @@
+// Compare synchronous read()/write() with the same
+// requests submitted through the async I/O rings.
+// usage: aiobench [nops [size [depth]]]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/fcntl.h"
+#include "kernel/aio.h"
+#include "user/user.h"
+
+#define MAXSIZE 4096
+
+char buf[MAXSIZE];
+char *file = "aiobench.tmp";
+
+int
+syncrun(int op, int nops, int size)
+{
+  int fd, i, t0;
+
+  t0 = uptime();
+  fd = open(file, op == AIO_WRITE ? O_CREATE|O_TRUNC|O_WRONLY : O_RDONLY);
+  if(fd < 0){
+    printf("aiobench: open %s failed\n", file);
+    exit(1);
+  }
+  for(i = 0; i < nops; i++){
+    if((op == AIO_WRITE ? write(fd, buf, size) : read(fd, buf, size)) != size){
+      printf("aiobench: sync op %d failed\n", i);
+      exit(1);
+    }
+  }
+  close(fd);
+  return uptime() - t0;
+}
+
+// Keep up to depth requests in flight; each aioenter()
+// submits everything queued so far and reaps at least one.
+int
+asyncrun(struct aio_ring *r, int op, int nops, int size, int depth)
+{
+  int fd, t0, sent, done, inflight;
+  struct aio_sqe *e;
+  struct aio_cqe *c;
+
+  t0 = uptime();
+  fd = open(file, op == AIO_WRITE ? O_CREATE|O_TRUNC|O_WRONLY : O_RDONLY);
+  if(fd < 0){
+    printf("aiobench: open %s failed\n", file);
+    exit(1);
+  }
+  sent = done = inflight = 0;
+  while(done < nops){
+    while(sent < nops && inflight < depth){
+      e = &r->sq[r->sq_tail % NSQE];
+      e->op = op;
+      e->fd = fd;
+      e->addr = (uint64) buf;
+      e->n = size;
+      e->udata = sent++;
+      r->sq_tail++;
+      inflight++;
+    }
+    aioenter(NSQE, 1);
+    while(r->cq_head != r->cq_tail){
+      c = &r->cq[r->cq_head % NCQE];
+      if(c->res != size){
+        printf("aiobench: async op %d failed\n", (int)c->udata);
+        exit(1);
+      }
+      r->cq_head++;
+      inflight--;
+      done++;
+    }
+  }
+  close(fd);
+  return uptime() - t0;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int nops = 200, size = 512, depth = 16;
+  int st, at;
+  struct aio_ring *r;
+
+  if(argc > 1)
+    nops = atoi(argv[1]);
+  if(argc > 2)
+    size = atoi(argv[2]);
+  if(argc > 3)
+    depth = atoi(argv[3]);
+  if(nops <= 0 || size <= 0 || size > MAXSIZE || depth <= 0 || depth > NSQE){
+    fprintf(stderr, "usage: aiobench [nops [size(<=%d) [depth(<=%d)]]]\n",
+            MAXSIZE, NSQE);
+    exit(1);
+  }
+  if((r = aiosetup()) == (struct aio_ring *)-1){
+    fprintf(stderr, "aiobench: aiosetup failed\n");
+    exit(1);
+  }
+  memset(buf, 'a', size);
+
+  printf("%d ops of %d bytes, async depth %d (ticks)\n", nops, size, depth);
+  st = syncrun(AIO_WRITE, nops, size);
+  at = asyncrun(r, AIO_WRITE, nops, size, depth);
+  printf("write: sync %d async %d\n", st, at);
+  st = syncrun(AIO_READ, nops, size);
+  at = asyncrun(r, AIO_READ, nops, size, depth);
+  printf("read:  sync %d async %d\n", st, at);
+  unlink(file);
+  exit(0);
+}
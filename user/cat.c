@@ -7,16 +7,27 @@ char buf[512];
 void
 cat(int fd)
 {
-  int n;
+  int n, tot;
+
+  // have the kernel move the data when it can (a file
+  // to a pipe or the console); otherwise copy it here.
+  for(tot = 0; (n = splice(fd, 1, 64*1024)) > 0; tot += n)
+    ;
+  if(n == 0)
+    return;
+  if(tot > 0){
+    fprintf(stderr, "cat: write error\n");
+    exit(1);
+  }
 
   while((n = read(fd, buf, sizeof(buf))) > 0) {
     if (write(1, buf, n) != n) {
-      fprintf(2, "cat: write error\n");
+      fprintf(stderr, "cat: write error\n");
       exit(1);
     }
   }
   if(n < 0){
-    fprintf(2, "cat: read error\n");
+    fprintf(stderr, "cat: read error\n");
     exit(1);
   }
 }
@@ -33,7 +44,7 @@ main(int argc, char *argv[])
 
   for(i = 1; i < argc; i++){
     if((fd = open(argv[i], 0)) < 0){
-      fprintf(2, "cat: cannot open %s\n", argv[i]);
+      fprintf(stderr, "cat: cannot open %s\n", argv[i]);
       exit(1);
     }
     cat(fd);
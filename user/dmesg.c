@@ -0,0 +1,34 @@
+// Print the kernel log: what the kernel has printed, as far
+// back as the log goes.
+// usage: dmesg
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/param.h"
+#include "kernel/klog.h"
+#include "user/user.h"
+
+int
+main(int argc, char *argv[])
+{
+  char *buf;
+  int n;
+
+  if(argc > 1){
+    fprintf(stderr, "usage: dmesg\n");
+    exit(1);
+  }
+  if((buf = malloc(KLOGMAX)) == 0){
+    fprintf(stderr, "dmesg: out of memory\n");
+    exit(1);
+  }
+  if((n = dmesg(buf, KLOGMAX)) < 0){
+    fprintf(stderr, "dmesg: dmesg failed\n");
+    exit(1);
+  }
+  if(write(1, buf, n) != n){
+    fprintf(stderr, "dmesg: write failed\n");
+    exit(1);
+  }
+  exit(0);
+}
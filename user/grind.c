@@ -224,11 +224,11 @@ go(int which_child)
       // echo hi | cat
       int aa[2], bb[2];
       if(pipe(aa) < 0){
-        fprintf(2, "pipe failed\n");
+        fprintf(stderr, "pipe failed\n");
         exit(1);
       }
       if(pipe(bb) < 0){
-        fprintf(2, "pipe failed\n");
+        fprintf(stderr, "pipe failed\n");
         exit(1);
       }
       int pid1 = fork();
@@ -238,16 +238,16 @@ go(int which_child)
         close(aa[0]);
         close(1);
         if(dup(aa[1]) != 1){
-          fprintf(2, "dup failed\n");
+          fprintf(stderr, "dup failed\n");
           exit(1);
         }
         close(aa[1]);
         char *args[3] = { "echo", "hi", 0 };
         exec("grindir/../echo", args);
-        fprintf(2, "echo: not found\n");
+        fprintf(stderr, "echo: not found\n");
         exit(2);
       } else if(pid1 < 0){
-        fprintf(2, "fork failed\n");
+        fprintf(stderr, "fork failed\n");
         exit(3);
       }
       int pid2 = fork();
@@ -256,22 +256,22 @@ go(int which_child)
         close(bb[0]);
         close(0);
         if(dup(aa[0]) != 0){
-          fprintf(2, "dup failed\n");
+          fprintf(stderr, "dup failed\n");
           exit(4);
         }
         close(aa[0]);
         close(1);
         if(dup(bb[1]) != 1){
-          fprintf(2, "dup failed\n");
+          fprintf(stderr, "dup failed\n");
           exit(5);
         }
         close(bb[1]);
         char *args[2] = { "cat", 0 };
         exec("/cat", args);
-        fprintf(2, "cat: not found\n");
+        fprintf(stderr, "cat: not found\n");
         exit(6);
       } else if(pid2 < 0){
-        fprintf(2, "fork failed\n");
+        fprintf(stderr, "fork failed\n");
         exit(7);
       }
       close(aa[0]);
@@ -22,6 +22,7 @@ main(void)
   }
   dup(0);  // stdout 0ͱʾϱߴ򿪵ĵһļﷵļ1
   dup(0);  // stderr ļ2
+  mknod("stats", STATS, 0);  // fails harmlessly if it exists
 
   for(;;){
     printf("init: starting sh\n");
@@ -0,0 +1,135 @@
+// Trace a command: enable kernel tracepoints while it runs,
+// collect the events, and print them decoded, in time order,
+// with times in microseconds from the first event. Events of
+// ktrace itself are left out.
+// usage: ktrace [-m mask] command [arg...]
+// mask selects event types as in kernel/ktrace.h (default all).
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/fcntl.h"
+#include "kernel/riscv.h"
+#include "kernel/memlayout.h"
+#include "kernel/ktrace.h"
+#include "user/user.h"
+
+#define MAXEVENT 16384
+#define NBATCH 64
+
+struct ktevent *ev;
+int nev, self;
+
+// Collect the events recorded so far.
+void
+drain(void)
+{
+  int i, j, n;
+
+  while(nev < MAXEVENT &&
+        (n = ktrace(KT_READ, MAXEVENT - nev < NBATCH ? MAXEVENT - nev : NBATCH, ev + nev)) > 0){
+    for(i = 0, j = nev; i < n; i++)
+      if(ev[nev+i].pid != self)
+        ev[j++] = ev[nev+i];
+    nev = j;
+  }
+}
+
+// Print e as: microseconds, cpu, pid, event.
+void
+print(struct ktevent *e, uint64 t0, uint64 perus)
+{
+  printf("%d %d %d ", (int)((e->time - t0) / perus), e->cpu, e->pid);
+  switch(e->type){
+  case KT_SYSCALL:
+    printf("syscall %s(%d)\n", sysname(e->a), (int)e->b);
+    break;
+  case KT_SYSRET:
+    printf("sysret %s = %d\n", sysname(e->a), (int)e->b);
+    break;
+  case KT_SWITCH:
+    printf("switch level %d\n", (int)e->a);
+    break;
+  case KT_BREAD:
+    printf("bread %d%s\n", (int)e->a, e->b ? " cached" : "");
+    break;
+  case KT_BWRITE:
+    printf("bwrite %d\n", (int)e->a);
+    break;
+  case KT_COMMIT:
+    printf("commit %d blocks\n", (int)e->a);
+    break;
+  case KT_COMMITTED:
+    printf("committed, %d in log\n", (int)e->a);
+    break;
+  case KT_DISKSUB:
+    printf("disk %s %d+%d\n", (e->b & 1) ? "write" : "read", (int)e->a, (int)(e->b / 2));
+    break;
+  case KT_DISKDONE:
+    printf("disk done %d\n", (int)e->a);
+    break;
+  case KT_FAULT:
+    printf("fault scause %p stval %p\n", e->a, e->b);
+    break;
+  default:
+    printf("event %d %p %p\n", e->type, e->a, e->b);
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  int mask = (1 << KT_NTYPE) - 1, fds[2], pid, lost, i;
+  uint64 perus;
+  struct pollfd pfd;
+
+  if(argc > 2 && strcmp(argv[1], "-m") == 0){
+    mask = atoi(argv[2]);
+    argv += 2;
+    argc -= 2;
+  }
+  if(argc < 2 || mask <= 0){
+    fprintf(stderr, "usage: ktrace [-m mask] command [arg...]\n");
+    exit(1);
+  }
+  if((ev = malloc(MAXEVENT * sizeof(*ev))) == 0){
+    fprintf(stderr, "ktrace: out of memory\n");
+    exit(1);
+  }
+  self = getpid();
+
+  // the command holds the write end of a pipe until it exits,
+  // so we can collect events while waiting for it.
+  if(pipe(fds) < 0){
+    fprintf(stderr, "ktrace: pipe failed\n");
+    exit(1);
+  }
+  ktrace(KT_START, mask, 0);
+  if((pid = fork()) < 0){
+    fprintf(stderr, "ktrace: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    close(fds[0]);
+    exec(argv[1], argv + 1);
+    fprintf(stderr, "ktrace: exec %s failed\n", argv[1]);
+    exit(1);
+  }
+  close(fds[1]);
+
+  pfd.fd = fds[0];
+  pfd.events = POLLIN;
+  do {
+    drain();
+    pfd.revents = 0;
+  } while(poll(&pfd, 1, 1) == 0 || !(pfd.revents & POLLHUP));
+  wait(0);
+  lost = ktrace(KT_STOP, 0, 0);
+  drain();
+
+  perus = ((struct usyscall*)USYSCALL)->timebase / 1000000;
+  for(i = 0; i < nev; i++)
+    print(&ev[i], ev[0].time, perus);
+  printf("ktrace: %d events, %d lost%s\n", nev, lost,
+         nev == MAXEVENT ? ", buffer full" : "");
+  exit(0);
+}
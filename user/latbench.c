@@ -0,0 +1,87 @@
+// Interactive response under CPU-bound load: nhogs children
+// spin while this process bounces a byte off an echo child
+// once a tick, timing each round trip.
+// usage: latbench [nhogs [rounds [hognice]]]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+#define MAXHOG 16
+
+int
+main(int argc, char *argv[])
+{
+  int nhogs = 4, rounds = 20, hognice = 0;
+  int hog[MAXHOG], to[2], from[2], pid, i;
+  uint64 t0, dt, sum, max;
+  char c;
+
+  if(argc > 1)
+    nhogs = atoi(argv[1]);
+  if(argc > 2)
+    rounds = atoi(argv[2]);
+  if(argc > 3)
+    hognice = atoi(argv[3]);
+  if(nhogs < 0 || nhogs > MAXHOG || rounds < 1){
+    fprintf(stderr, "usage: latbench [nhogs(0-%d) [rounds [hognice]]]\n", MAXHOG);
+    exit(1);
+  }
+
+  if(pipe(to) < 0 || pipe(from) < 0){
+    fprintf(stderr, "latbench: pipe failed\n");
+    exit(1);
+  }
+  if((pid = fork()) < 0){
+    fprintf(stderr, "latbench: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    close(to[1]);
+    close(from[0]);
+    while(read(to[0], &c, 1) == 1)
+      write(from[1], &c, 1);
+    exit(0);
+  }
+  close(to[0]);
+  close(from[1]);
+
+  for(i = 0; i < nhogs; i++){
+    if((hog[i] = fork()) < 0){
+      fprintf(stderr, "latbench: fork failed\n");
+      exit(1);
+    }
+    if(hog[i] == 0){
+      volatile uint n = 0;
+      if(hognice > 0)
+        nice(hognice);
+      for(;;)
+        n++;
+    }
+  }
+  sleep(2);  // let the hogs use up their time slices
+
+  sum = max = 0;
+  for(i = 0; i < rounds; i++){
+    sleep(1);
+    t0 = uptimeus();
+    if(write(to[1], "x", 1) != 1 || read(from[0], &c, 1) != 1){
+      fprintf(stderr, "latbench: echo failed\n");
+      exit(1);
+    }
+    dt = uptimeus() - t0;
+    sum += dt;
+    if(dt > max)
+      max = dt;
+  }
+
+  for(i = 0; i < nhogs; i++){
+    kill(hog[i]);
+    wait(0);
+  }
+  close(to[1]);
+  wait(0);
+  printf("%d hogs (nice %d): round trip avg %d us, max %d us\n",
+         nhogs, hognice, (int)(sum / rounds), (int)max);
+  exit(0);
+}
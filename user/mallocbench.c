@@ -0,0 +1,96 @@
+// Allocator speed: malloc() and free() in a loop over a working
+// set of live blocks, first of small random sizes, then with the
+// heap fragmented by many long-lived small blocks, then of large
+// blocks. Prints the average time per operation, and the heap
+// size with many large blocks live and once they are freed.
+// usage: mallocbench [ops]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+#define NSLOT 512
+#define NPIN  4096
+#define NBIG  256
+
+char *slot[NSLOT];
+char *pin[NPIN];
+uint seed = 1;
+
+uint
+rnd(void)
+{
+  seed = seed * 1103515245 + 12345;
+  return seed >> 8;
+}
+
+// ops random mallocs and frees over NSLOT slots, of sizes
+// from 1 up to maxsz; returns the time taken in microseconds.
+uint64
+run(int ops, uint maxsz)
+{
+  uint64 t0;
+  int i, k;
+
+  t0 = uptimeus();
+  for(i = 0; i < ops; i++){
+    k = rnd() % NSLOT;
+    if(slot[k]){
+      free(slot[k]);
+      slot[k] = 0;
+    } else if((slot[k] = malloc(rnd() % maxsz + 1)) == 0){
+      fprintf(stderr, "mallocbench: out of memory\n");
+      exit(1);
+    } else {
+      slot[k][0] = i;  // touch it
+    }
+  }
+  for(k = 0; k < NSLOT; k++){
+    free(slot[k]);
+    slot[k] = 0;
+  }
+  return uptimeus() - t0;
+}
+
+void
+report(char *what, int ops, uint64 t)
+{
+  printf("%s: %d ops, %d ns/op\n", what, ops, (int)(t * 1000 / ops));
+}
+
+int
+main(int argc, char *argv[])
+{
+  int ops = 100000, i;
+
+  if(argc > 1)
+    ops = atoi(argv[1]);
+  if(ops < 10){
+    fprintf(stderr, "usage: mallocbench [ops]\n");
+    exit(1);
+  }
+
+  report("small (1-256 bytes)", ops, run(ops, 256));
+
+  // pin down many small blocks, every other one freed, which
+  // leaves a long free list for a first-fit allocator to walk.
+  for(i = 0; i < NPIN; i++)
+    pin[i] = malloc(rnd() % 64 + 1);
+  for(i = 0; i < NPIN; i += 2){
+    free(pin[i]);
+    pin[i] = 0;
+  }
+  report("small, fragmented heap", ops, run(ops, 256));
+  for(i = 0; i < NPIN; i++)
+    free(pin[i]);
+
+  report("large (up to 64 KB)", ops / 10, run(ops / 10, 64*1024));
+
+  for(i = 0; i < NBIG; i++)
+    slot[i] = malloc(64*1024);
+  printf("heap: %d KB with %d 64 KB blocks, ", (int)((uint64)sbrk(0) / 1024), NBIG);
+  for(i = 0; i < NBIG; i++)
+    free(slot[i]);
+  printf("%d KB once freed\n", (int)((uint64)sbrk(0) / 1024));
+  exit(0);
+}
@@ -8,13 +8,13 @@ main(int argc, char *argv[])
   int i;
 
   if(argc < 2){
-    fprintf(2, "Usage: mkdir files...\n");
+    fprintf(stderr, "Usage: mkdir files...\n");
     exit(1);
   }
 
   for(i = 1; i < argc; i++){
     if(mkdir(argv[i]) < 0){
-      fprintf(2, "mkdir: %s failed to create\n", argv[i]);
+      fprintf(stderr, "mkdir: %s failed to create\n", argv[i]);
       break;
     }
   }
@@ -0,0 +1,75 @@
+// Pipe throughput: a child writes nkb kilobytes into a pipe
+// in chunks of a given size while the parent reads them,
+// once for each of several pipe buffer sizes.
+// usage: pipebench [nkb [chunk]]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+
+#define MAXCHUNK 8192
+
+char buf[MAXCHUNK];
+
+void
+run(int pipesz, int nkb, int chunk)
+{
+  int fds[2], pid, n, tot, t0, total = nkb * 1024;
+
+  if(pipe(fds) < 0){
+    fprintf(stderr, "pipebench: pipe failed\n");
+    exit(1);
+  }
+  if((pipesz = fcntl(fds[1], F_SETPIPE_SZ, pipesz)) < 0){
+    fprintf(stderr, "pipebench: F_SETPIPE_SZ failed\n");
+    exit(1);
+  }
+  t0 = uptime();
+  pid = fork();
+  if(pid < 0){
+    fprintf(stderr, "pipebench: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    close(fds[0]);
+    for(tot = 0; tot < total; tot += n){
+      n = total - tot < chunk ? total - tot : chunk;
+      if(write(fds[1], buf, n) != n){
+        fprintf(stderr, "pipebench: write failed\n");
+        exit(1);
+      }
+    }
+    exit(0);
+  }
+  close(fds[1]);
+  for(tot = 0; (n = read(fds[0], buf, chunk)) > 0; tot += n)
+    ;
+  close(fds[0]);
+  wait(0);
+  if(tot != total){
+    fprintf(stderr, "pipebench: read %d bytes, not %d\n", tot, total);
+    exit(1);
+  }
+  printf("pipe %d bytes: %d KB in %d-byte chunks, %d ticks\n",
+         pipesz, nkb, chunk, uptime() - t0);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int nkb = 4096, chunk = 4096;
+
+  if(argc > 1)
+    nkb = atoi(argv[1]);
+  if(argc > 2)
+    chunk = atoi(argv[2]);
+  if(nkb <= 0 || chunk <= 0 || chunk > MAXCHUNK){
+    fprintf(stderr, "usage: pipebench [nkb [chunk(<=%d)]]\n", MAXCHUNK);
+    exit(1);
+  }
+  run(4096, nkb, chunk);
+  run(4*4096, nkb, chunk);
+  run(16*4096, nkb, chunk);
+  exit(0);
+}
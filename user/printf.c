@@ -6,21 +6,33 @@
 
 static char digits[] = "0123456789ABCDEF";
 
+// Output is formatted into a small buffer and handed to
+// fwrite() a chunk at a time, not written a byte at a time.
+struct out {
+  FILE *f;
+  int n;
+  char buf[128];
+};
+
 static void
-putc(int fd, char c)
+putc(struct out *o, char c)
 {
-  write(fd, &c, 1);
+  if(o->n == sizeof(o->buf)){
+    fwrite(o->buf, 1, o->n, o->f);
+    o->n = 0;
+  }
+  o->buf[o->n++] = c;
 }
 
 static void
-printint(int fd, int xx, int base, int sgn)
+printint(struct out *o, uint64 xx, int base, int sgn)
 {
-  char buf[16];
+  char buf[24];
   int i, neg;
-  uint x;
+  uint64 x;
 
   neg = 0;
-  if(sgn && xx < 0){
+  if(sgn && (long)xx < 0){
     neg = 1;
     x = -xx;
   } else {
@@ -35,25 +47,28 @@ printint(int fd, int xx, int base, int sgn)
     buf[i++] = '-';
 
   while(--i >= 0)
-    putc(fd, buf[i]);
+    putc(o, buf[i]);
 }
 
 static void
-printptr(int fd, uint64 x) {
+printptr(struct out *o, uint64 x) {
   int i;
-  putc(fd, '0');
-  putc(fd, 'x');
+  putc(o, '0');
+  putc(o, 'x');
   for (i = 0; i < (sizeof(uint64) * 2); i++, x <<= 4)
-    putc(fd, digits[x >> (sizeof(uint64) * 8 - 4)]);
+    putc(o, digits[x >> (sizeof(uint64) * 8 - 4)]);
 }
 
-// Print to the given fd. Only understands %d, %x, %p, %s.
+// Print to the given stream. Only understands %d, %x, %p, %s.
 void
-vprintf(int fd, const char *fmt, va_list ap)
+vprintf(FILE *f, const char *fmt, va_list ap)
 {
+  struct out o;
   char *s;
   int c, i, state;
 
+  o.f = f;
+  o.n = 0;
   state = 0;
   for(i = 0; fmt[i]; i++){
     c = fmt[i] & 0xff;
@@ -61,46 +76,47 @@ vprintf(int fd, const char *fmt, va_list ap)
       if(c == '%'){
         state = '%';
       } else {
-        putc(fd, c);
+        putc(&o, c);
       }
     } else if(state == '%'){
       if(c == 'd'){
-        printint(fd, va_arg(ap, int), 10, 1);
+        printint(&o, va_arg(ap, int), 10, 1);
       } else if(c == 'l') {
-        printint(fd, va_arg(ap, uint64), 10, 0);
+        printint(&o, va_arg(ap, uint64), 10, 0);
       } else if(c == 'x') {
-        printint(fd, va_arg(ap, int), 16, 0);
+        printint(&o, (uint)va_arg(ap, int), 16, 0);
       } else if(c == 'p') {
-        printptr(fd, va_arg(ap, uint64));
+        printptr(&o, va_arg(ap, uint64));
       } else if(c == 's'){
         s = va_arg(ap, char*);
         if(s == 0)
           s = "(null)";
         while(*s != 0){
-          putc(fd, *s);
+          putc(&o, *s);
           s++;
         }
       } else if(c == 'c'){
-        putc(fd, va_arg(ap, uint));
+        putc(&o, va_arg(ap, uint));
       } else if(c == '%'){
-        putc(fd, c);
+        putc(&o, c);
       } else {
         // Unknown % sequence.  Print it to draw attention.
-        putc(fd, '%');
-        putc(fd, c);
+        putc(&o, '%');
+        putc(&o, c);
       }
       state = 0;
     }
   }
+  fwrite(o.buf, 1, o.n, f);
 }
 
 void
-fprintf(int fd, const char *fmt, ...)
+fprintf(FILE *f, const char *fmt, ...)
 {
   va_list ap;
 
   va_start(ap, fmt);
-  vprintf(fd, fmt, ap);
+  vprintf(f, fmt, ap);
 }
 
 void
@@ -109,5 +125,5 @@ printf(const char *fmt, ...)
   va_list ap;  // ʹva_listɱ
 
   va_start(ap, fmt);
-  vprintf(1, fmt, ap);  // ļ̶Ϊ1
+  vprintf(stdout, fmt, ap);  // ̶stdout
 }
@@ -0,0 +1,81 @@
+// Profile a command: sample every CPU while it runs, and print
+// each sample as a line for profsym.py on the host to turn into
+// a flat profile of the kernel and user functions hit.
+// usage: prof [-i usec] command [arg...]
+// usec is at least PROF_MININTERVAL (100).
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/fcntl.h"
+#include "kernel/prof.h"
+#include "user/user.h"
+
+#define NBATCH 64
+
+struct profsample s[NBATCH];
+int nsample;
+
+// Print the samples taken so far.
+void
+drain(void)
+{
+  int i, n;
+
+  while((n = prof(PROF_READ, NBATCH, s)) > 0){
+    for(i = 0; i < n; i++)
+      printf("prof: %d %d %s %c %p\n", s[i].cpu, s[i].pid, s[i].name,
+             s[i].user ? 'u' : 'k', s[i].pc);
+    nsample += n;
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  int interval = 1000, fds[2], pid, dropped;
+  struct pollfd pfd;
+
+  if(argc > 2 && strcmp(argv[1], "-i") == 0){
+    interval = atoi(argv[2]);
+    argv += 2;
+    argc -= 2;
+  }
+  if(argc < 2 || interval < PROF_MININTERVAL){
+    fprintf(stderr, "usage: prof [-i usec] command [arg...]\n");
+    exit(1);
+  }
+
+  // the command holds the write end of a pipe until it exits,
+  // so we can drain samples while waiting for it.
+  if(pipe(fds) < 0){
+    fprintf(stderr, "prof: pipe failed\n");
+    exit(1);
+  }
+  if(prof(PROF_START, interval, 0) < 0){
+    fprintf(stderr, "prof: can't start profiling\n");
+    exit(1);
+  }
+  if((pid = fork()) < 0){
+    fprintf(stderr, "prof: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    close(fds[0]);
+    exec(argv[1], argv + 1);
+    fprintf(stderr, "prof: exec %s failed\n", argv[1]);
+    exit(1);
+  }
+  close(fds[1]);
+
+  pfd.fd = fds[0];
+  pfd.events = POLLIN;
+  do {
+    drain();
+    pfd.revents = 0;
+  } while(poll(&pfd, 1, 1) == 0 || !(pfd.revents & POLLHUP));
+  wait(0);
+  dropped = prof(PROF_STOP, 0, 0);
+  drain();
+  printf("prof: %d samples, %d dropped\n", nsample, dropped);
+  exit(0);
+}
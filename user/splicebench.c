@@ -0,0 +1,113 @@
+// Move a file through a pipe the way cat does, with
+// read() and write(), and then with splice(), counting
+// the producer's system calls and the bytes it copies
+// through user space.
+// usage: splicebench [kbytes]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+
+char buf[512];
+char *file = "splicebench.tmp";
+
+// Producer: send file to fd, return the number of syscalls.
+int
+produce(int fd, int usesplice)
+{
+  int in, n, calls;
+
+  if((in = open(file, O_RDONLY)) < 0){
+    fprintf(stderr, "splicebench: open %s failed\n", file);
+    exit(1);
+  }
+  calls = 1;
+  if(usesplice){
+    do {
+      n = splice(in, fd, 64*1024);
+      calls++;
+    } while(n > 0);
+  } else {
+    while((n = read(in, buf, sizeof(buf))) > 0){
+      calls++;
+      if(write(fd, buf, n) != n){
+        fprintf(stderr, "splicebench: write failed\n");
+        exit(1);
+      }
+      calls++;
+    }
+    calls++;
+  }
+  if(n < 0){
+    fprintf(stderr, "splicebench: transfer failed\n");
+    exit(1);
+  }
+  close(in);
+  return calls + 1;
+}
+
+void
+run(char *name, int usesplice, int size)
+{
+  int fds[2], pid, n, tot, calls, t0;
+
+  if(pipe(fds) < 0){
+    fprintf(stderr, "splicebench: pipe failed\n");
+    exit(1);
+  }
+  t0 = uptime();
+  pid = fork();
+  if(pid < 0){
+    fprintf(stderr, "splicebench: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    close(fds[0]);
+    exit(produce(fds[1], usesplice));
+  }
+  close(fds[1]);
+  tot = 0;
+  while((n = read(fds[0], buf, sizeof(buf))) > 0)
+    tot += n;
+  close(fds[0]);
+  wait(&calls);
+  if(tot != size){
+    fprintf(stderr, "splicebench: %s moved %d bytes, not %d\n", name, tot, size);
+    exit(1);
+  }
+  printf("%s: %d bytes, %d syscalls, %d bytes via user space, %d ticks\n",
+         name, tot, calls, usesplice ? 0 : 2*tot, uptime() - t0);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int fd, i, kb = 64;
+
+  if(argc > 1)
+    kb = atoi(argv[1]);
+  if(kb <= 0){
+    fprintf(stderr, "usage: splicebench [kbytes]\n");
+    exit(1);
+  }
+
+  if((fd = open(file, O_CREATE|O_TRUNC|O_WRONLY)) < 0){
+    fprintf(stderr, "splicebench: create %s failed\n", file);
+    exit(1);
+  }
+  memset(buf, 'x', sizeof(buf));
+  for(i = 0; i < kb*2; i++){
+    if(write(fd, buf, sizeof(buf)) != sizeof(buf)){
+      fprintf(stderr, "splicebench: write %s failed\n", file);
+      exit(1);
+    }
+  }
+  close(fd);
+
+  printf("producer side of moving %d KB through a pipe:\n", kb);
+  run("read/write", 0, kb*1024);
+  run("splice", 1, kb*1024);
+  unlink(file);
+  exit(0);
+}
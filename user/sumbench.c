@@ -0,0 +1,106 @@
+// Parallel sum: threads made with thread_create() each sum a
+// slice of one shared array, for 1 up to maxthreads threads.
+// The speedup over one thread shows the threads running on
+// several CPUs at once.
+// usage: sumbench [maxthreads [passes]]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+#define N (256*1024)
+#define MAXTHREAD 8
+
+uint *a;
+int passes;
+
+// one result per thread, a cache line apart.
+struct slice {
+  int lo, hi;
+  uint64 sum;
+  char pad[48];
+} slices[MAXTHREAD];
+
+void
+sum(void *arg)
+{
+  struct slice *s = arg;
+  uint64 t;
+
+  s->sum = 0;
+  for(int p = 0; p < passes; p++){
+    t = 0;
+    for(int i = s->lo; i < s->hi; i++)
+      t += a[i];
+    s->sum += t;
+  }
+}
+
+// Sum with n threads; returns the time taken in microseconds.
+uint64
+run(int n, uint64 *total)
+{
+  int tid[MAXTHREAD];
+  uint64 t0;
+  int i;
+
+  t0 = uptimeus();
+  for(i = 0; i < n; i++){
+    slices[i].lo = (uint64)N * i / n;
+    slices[i].hi = (uint64)N * (i+1) / n;
+    if((tid[i] = thread_create(sum, &slices[i])) < 0){
+      fprintf(stderr, "sumbench: thread_create failed\n");
+      exit(1);
+    }
+  }
+  *total = 0;
+  for(i = 0; i < n; i++){
+    if(thread_join(tid[i]) != tid[i]){
+      fprintf(stderr, "sumbench: thread_join failed\n");
+      exit(1);
+    }
+    *total += slices[i].sum;
+  }
+  return uptimeus() - t0;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int maxthreads = 4;
+  uint64 want, total, t, t1;
+
+  if(argc > 1)
+    maxthreads = atoi(argv[1]);
+  passes = argc > 2 ? atoi(argv[2]) : 20;
+  if(maxthreads < 1 || maxthreads > MAXTHREAD || passes < 1){
+    fprintf(stderr, "usage: sumbench [maxthreads(1-%d) [passes]]\n", MAXTHREAD);
+    exit(1);
+  }
+
+  if((a = malloc(N * sizeof(uint))) == 0){
+    fprintf(stderr, "sumbench: out of memory\n");
+    exit(1);
+  }
+  want = 0;
+  for(int i = 0; i < N; i++){
+    a[i] = i * 7 + 1;
+    want += a[i];
+  }
+  want *= passes;
+
+  t1 = 0;
+  for(int n = 1; n <= maxthreads; n++){
+    if((t = run(n, &total)) == 0)
+      t = 1;
+    if(total != want){
+      fprintf(stderr, "sumbench: %d threads got the wrong sum\n", n);
+      exit(1);
+    }
+    if(n == 1)
+      t1 = t;
+    printf("%d threads: %d us, speedup %d.%d%dx\n", n, (int)t,
+           (int)(t1 / t), (int)(t1 * 10 / t % 10), (int)(t1 * 100 / t % 10));
+  }
+  exit(0);
+}
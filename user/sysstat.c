@@ -0,0 +1,125 @@
+// Show system call statistics: for each system call made, how
+// often, how much time in all, and the mean, median, 99th
+// percentile and longest time of a call, busiest first.
+// usage: sysstat [-z] [-v] [-p pid] [command [arg...]]
+// -z clears the system-wide statistics; with a command they are
+// cleared, the command run, and the statistics of the run shown.
+// -v adds a latency histogram of each call, -p shows only calls
+// made by process pid (which has no latency distribution).
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/param.h"
+#include "kernel/riscv.h"
+#include "kernel/memlayout.h"
+#include "kernel/sysstat.h"
+#include "user/user.h"
+
+struct sysstat st[NSYSCALL];
+int order[NSYSCALL];
+uint64 perus;
+
+// cycles as nanoseconds.
+uint64
+ns(uint64 cycles)
+{
+  return cycles * 1000 / perus;
+}
+
+// An upper bound on the time of the fastest pct% of the
+// calls, from the histogram.
+uint64
+percentile(struct sysstat *s, int pct)
+{
+  uint64 n = 0;
+  int b;
+
+  for(b = 0; b < NSYSHIST-1; b++){
+    n += s->hist[b];
+    if(n * 100 >= s->count * pct)
+      break;
+  }
+  if(b == NSYSHIST-1 || (2UL << b) > s->max)
+    return s->max;
+  return 2UL << b;
+}
+
+void
+histogram(struct sysstat *s)
+{
+  int b;
+
+  for(b = 0; b < NSYSHIST; b++)
+    if(s->hist[b])
+      printf("    %s%l ns: %d\n", b == NSYSHIST-1 ? ">= " : "< ",
+             ns(b == NSYSHIST-1 ? 1UL << b : 2UL << b), s->hist[b]);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int pid = 0, verbose = 0, i, j, n, k;
+  struct sysstat *s;
+
+  for(; argc > 1 && argv[1][0] == '-'; argc--, argv++){
+    if(strcmp(argv[1], "-z") == 0){
+      sysstat(-1, 0, 0);
+      exit(0);
+    } else if(strcmp(argv[1], "-v") == 0){
+      verbose = 1;
+    } else if(strcmp(argv[1], "-p") == 0 && argc > 2){
+      pid = atoi(argv[2]);
+      argc--;
+      argv++;
+    } else {
+      fprintf(stderr, "usage: sysstat [-z] [-v] [-p pid] [command [arg...]]\n");
+      exit(1);
+    }
+  }
+
+  if(argc > 1){
+    sysstat(-1, 0, 0);
+    if((k = fork()) < 0){
+      fprintf(stderr, "sysstat: fork failed\n");
+      exit(1);
+    }
+    if(k == 0){
+      exec(argv[1], argv + 1);
+      fprintf(stderr, "sysstat: exec %s failed\n", argv[1]);
+      exit(1);
+    }
+    wait(0);
+  }
+
+  // sort the calls made by total time, largest first.
+  n = 0;
+  for(i = 1; i < NSYSCALL; i++){
+    if(sysstat(pid, i, &st[i]) < 0){
+      fprintf(stderr, "sysstat: no process %d\n", pid);
+      exit(1);
+    }
+    if(st[i].count == 0)
+      continue;
+    for(j = n++; j > 0 && st[order[j-1]].cycles < st[i].cycles; j--)
+      order[j] = order[j-1];
+    order[j] = i;
+  }
+
+  perus = ((struct usyscall*)USYSCALL)->timebase / 1000000;
+  if(pid)
+    printf("%s %s %s %s\n", "call", "count", "total-us", "mean-ns");
+  else
+    printf("%s %s %s %s %s %s %s\n", "call", "count", "total-us",
+           "mean-ns", "p50-ns", "p99-ns", "max-ns");
+  for(i = 0; i < n; i++){
+    s = &st[order[i]];
+    printf("%s %l %l %l", sysname(order[i]), s->count,
+           s->cycles / perus, ns(s->cycles / s->count));
+    if(pid == 0)
+      printf(" %l %l %l", ns(percentile(s, 50)), ns(percentile(s, 99)), ns(s->max));
+    printf("\n");
+    if(verbose && pid == 0)
+      histogram(s);
+  }
+  exit(0);
+}
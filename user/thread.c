@@ -0,0 +1,123 @@
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "user/user.h"
+
+// Threads on top of clone() and join(). Each thread gets a
+// malloc()ed stack, freed again by thread_join(). malloc() is
+// not thread-safe, so create and join threads from one thread.
+
+#define TSTACK (4*4096)
+
+// kept at the top of a new thread's stack.
+struct tstart {
+  void (*fn)(void*);
+  void *arg;
+};
+
+static void
+tstart(void *a)
+{
+  struct tstart *t = a;
+
+  t->fn(t->arg);
+  _exit(0);  // not exit(): another thread may be using stdio
+}
+
+// Run fn(arg) in a new thread. Returns its id, or -1.
+int
+thread_create(void (*fn)(void*), void *arg)
+{
+  char *stack;
+  struct tstart *t;
+  int tid;
+
+  if((stack = malloc(TSTACK)) == 0)
+    return -1;
+  t = (struct tstart*)(stack + TSTACK) - 1;
+  t->fn = fn;
+  t->arg = arg;
+  if((tid = clone(tstart, t, t)) < 0)
+    free(stack);
+  return tid;
+}
+
+// Wait for thread tid to finish and free its stack.
+// Returns tid, or -1.
+int
+thread_join(int tid)
+{
+  void *t;
+
+  if((tid = join(tid, &t)) < 0)
+    return -1;
+  free((char*)((struct tstart*)t + 1) - TSTACK);
+  return tid;
+}
+
+// Mutexes and condition variables, which sleep in futex_wait()
+// rather than spin. After Drepper, "Futexes Are Tricky".
+
+void
+mutex_init(struct mutex *m)
+{
+  m->state = 0;
+}
+
+void
+mutex_lock(struct mutex *m)
+{
+  int c;
+
+  if((c = __sync_val_compare_and_swap(&m->state, 0, 1)) == 0)
+    return;
+  // contended: mark the mutex as having waiters, and sleep
+  // until it is handed back unlocked.
+  if(c != 2)
+    c = __sync_lock_test_and_set(&m->state, 2);
+  while(c != 0){
+    futex_wait(&m->state, 2);
+    c = __sync_lock_test_and_set(&m->state, 2);
+  }
+}
+
+void
+mutex_unlock(struct mutex *m)
+{
+  // only a mutex with waiters needs a system call.
+  if(__sync_fetch_and_sub(&m->state, 1) != 1){
+    __sync_lock_release(&m->state);
+    futex_wake(&m->state, 1);
+  }
+}
+
+void
+cond_init(struct cond *c)
+{
+  c->seq = 0;
+}
+
+// Unlock m and sleep until signalled, then lock m again.
+// Like any condition variable, it may wake spuriously.
+void
+cond_wait(struct cond *c, struct mutex *m)
+{
+  int seq = c->seq;
+
+  mutex_unlock(m);
+  futex_wait(&c->seq, seq);  // returns at once if signalled since
+  mutex_lock(m);
+}
+
+void
+cond_signal(struct cond *c)
+{
+  __sync_fetch_and_add(&c->seq, 1);
+  futex_wake(&c->seq, 1);
+}
+
+void
+cond_broadcast(struct cond *c)
+{
+  __sync_fetch_and_add(&c->seq, 1);
+  futex_wake(&c->seq, NPROC);
+}
@@ -1,6 +1,10 @@
 #include "kernel/types.h"
 #include "kernel/stat.h"
 #include "kernel/fcntl.h"
+#include "kernel/riscv.h"
+#include "kernel/memlayout.h"
+#include "kernel/param.h"
+#include "kernel/syscall.h"
 #include "user/user.h"
 
 char*
@@ -58,6 +62,7 @@ gets(char *buf, int max)
   int i, cc;
   char c;
 
+  fflush(stdout);  // show any prompt first
   for(i=0; i+1 < max; ){
     cc = read(0, &c, 1);  // ʹreadϵͳôļ0Ҳconsoleȡһַ
     if(cc < 1)
@@ -134,3 +139,366 @@ memcpy(void *dst, const void *src, uint n)
 {
   return memmove(dst, src, n);
 }
+
+// The following read the kernel's USYSCALL page
+// instead of trapping into the kernel.
+
+int
+ugetpid(void)
+{
+  return ((struct usyscall *)USYSCALL)->pid;
+}
+
+int
+uuptime(void)
+{
+  return ((volatile struct usyscall *)USYSCALL)->ticks;
+}
+
+// Microseconds since boot, from the time CSR.
+uint64
+uptimeus(void)
+{
+  uint64 t;
+
+  asm volatile("rdtime %0" : "=r" (t));
+  return t / (((struct usyscall *)USYSCALL)->timebase / 1000000);
+}
+
+// Change the caller's nice value by inc, within the levels the
+// scheduler has; a larger value means a lower priority.
+// Returns the new value.
+int
+nice(int inc)
+{
+  int n = setpriority(0, -1) + inc;
+
+  if(n < 0)
+    n = 0;
+  if(n > NMLFQ-1)
+    n = NMLFQ-1;
+  setpriority(0, n);
+  return n;
+}
+
+static char *syscalls[] = {
+[SYS_fork]    "fork",
+[SYS_exit]    "exit",
+[SYS_wait]    "wait",
+[SYS_pipe]    "pipe",
+[SYS_read]    "read",
+[SYS_kill]    "kill",
+[SYS_exec]    "exec",
+[SYS_fstat]   "fstat",
+[SYS_chdir]   "chdir",
+[SYS_dup]     "dup",
+[SYS_getpid]  "getpid",
+[SYS_sbrk]    "sbrk",
+[SYS_sleep]   "sleep",
+[SYS_uptime]  "uptime",
+[SYS_open]    "open",
+[SYS_write]   "write",
+[SYS_mknod]   "mknod",
+[SYS_unlink]  "unlink",
+[SYS_link]    "link",
+[SYS_mkdir]   "mkdir",
+[SYS_close]   "close",
+[SYS_aiosetup] "aiosetup",
+[SYS_aioenter] "aioenter",
+[SYS_readv]   "readv",
+[SYS_writev]  "writev",
+[SYS_pread]   "pread",
+[SYS_pwrite]  "pwrite",
+[SYS_lseek]   "lseek",
+[SYS_splice]  "splice",
+[SYS_fcntl]   "fcntl",
+[SYS_poll]    "poll",
+[SYS_epoll_create] "epoll_create",
+[SYS_epoll_ctl] "epoll_ctl",
+[SYS_epoll_wait] "epoll_wait",
+[SYS_clone]   "clone",
+[SYS_join]    "join",
+[SYS_futex_wait] "futex_wait",
+[SYS_futex_wake] "futex_wake",
+[SYS_setpriority] "setpriority",
+[SYS_nanosleep] "nanosleep",
+[SYS_prof]    "prof",
+[SYS_ktrace]  "ktrace",
+[SYS_sysstat] "sysstat",
+[SYS_dmesg]   "dmesg",
+};
+
+// The name of system call num, or "?".
+char*
+sysname(int num)
+{
+  if(num >= 0 && num < sizeof(syscalls)/sizeof(syscalls[0]) && syscalls[num])
+    return syscalls[num];
+  return "?";
+}
+
+// Buffered streams: a small stdio. Output to the console is
+// line buffered, output to files and pipes fully buffered, and
+// stderr is written out at the end of each call. exit(), fork()
+// and exec() flush everything first, so buffered output is
+// neither lost nor written twice. Not thread-safe.
+
+#define NSTREAM 8
+
+#define S_READ   0x01
+#define S_WRITE  0x02
+#define S_LINE   0x04  // flush output at each newline
+#define S_UNBUF  0x08  // flush output at the end of each call
+#define S_PROBED 0x10  // checked whether fd is the console
+#define S_EOF    0x20
+#define S_ERR    0x40
+
+struct stream {
+  int fd;
+  int flags;  // 0 if the slot is free
+  int n;      // bytes in buf
+  int pos;    // next input byte in buf
+  char *buf;
+};
+
+static char sbuf[NSTREAM][BUFSIZ];
+static struct stream streams[NSTREAM] = {
+  { 0, S_READ, 0, 0, sbuf[0] },
+  { 1, S_WRITE, 0, 0, sbuf[1] },
+  { 2, S_WRITE|S_UNBUF, 0, 0, sbuf[2] },
+};
+FILE *stdin = &streams[0];
+FILE *stdout = &streams[1];
+FILE *stderr = &streams[2];
+
+// Parse an fopen() mode: "r", "w" or "a".
+static int
+fmode(const char *mode, int *omode)
+{
+  switch(mode[0]){
+  case 'r':
+    *omode = O_RDONLY;
+    return S_READ;
+  case 'w':
+    *omode = O_WRONLY|O_CREATE|O_TRUNC;
+    return S_WRITE;
+  case 'a':
+    *omode = O_WRONLY|O_CREATE;
+    return S_WRITE;
+  }
+  return 0;
+}
+
+FILE*
+fdopen(int fd, const char *mode)
+{
+  struct stream *f;
+  int flags, omode;
+
+  if(fd < 0 || (flags = fmode(mode, &omode)) == 0)
+    return 0;
+  for(f = streams; f < &streams[NSTREAM]; f++){
+    if(f->flags == 0){
+      f->fd = fd;
+      f->flags = flags;
+      f->n = f->pos = 0;
+      f->buf = sbuf[f - streams];
+      return f;
+    }
+  }
+  return 0;
+}
+
+FILE*
+fopen(const char *path, const char *mode)
+{
+  FILE *f;
+  int fd, omode;
+
+  if(fmode(mode, &omode) == 0 || (fd = open(path, omode)) < 0)
+    return 0;
+  if(mode[0] == 'a')
+    lseek(fd, 0, SEEK_END);
+  if((f = fdopen(fd, mode)) == 0)
+    close(fd);
+  return f;
+}
+
+// Write out f's buffered output.
+static int
+flush(FILE *f)
+{
+  int i, m;
+
+  for(i = 0; i < f->n; i += m){
+    if((m = write(f->fd, f->buf + i, f->n - i)) <= 0){
+      f->flags |= S_ERR;
+      f->n = 0;
+      return EOF;
+    }
+  }
+  f->n = 0;
+  return 0;
+}
+
+// Flush f, or every output stream if f is 0.
+int
+fflush(FILE *f)
+{
+  int r = 0;
+
+  if(f)
+    return (f->flags & S_WRITE) ? flush(f) : 0;
+  for(f = streams; f < &streams[NSTREAM]; f++)
+    if((f->flags & S_WRITE) && f->n > 0 && flush(f) < 0)
+      r = EOF;
+  return r;
+}
+
+int
+fclose(FILE *f)
+{
+  int r;
+
+  r = fflush(f);
+  if(close(f->fd) < 0)
+    r = EOF;
+  f->flags = 0;
+  return r;
+}
+
+int
+fwrite(const void *p, int size, int nmemb, FILE *f)
+{
+  const char *s = p;
+  int n = size * nmemb, i, m, nl;
+  struct stat st;
+
+  if(!(f->flags & S_WRITE) || n <= 0)
+    return 0;
+  if(!(f->flags & S_PROBED)){
+    f->flags |= S_PROBED;
+    if(fstat(f->fd, &st) == 0 && st.type == T_DEVICE)
+      f->flags |= S_LINE;
+  }
+
+  nl = 0;
+  for(i = 0; i < n; i += m){
+    if(f->n == BUFSIZ && flush(f) < 0)
+      return i / size;
+    if(f->n == 0 && n - i >= BUFSIZ){
+      // too big to be worth buffering.
+      if((m = write(f->fd, s + i, n - i)) <= 0){
+        f->flags |= S_ERR;
+        return i / size;
+      }
+      continue;
+    }
+    m = n - i < BUFSIZ - f->n ? n - i : BUFSIZ - f->n;
+    memmove(f->buf + f->n, s + i, m);
+    f->n += m;
+  }
+  if(f->flags & S_LINE)
+    for(i = 0; i < n && !nl; i++)
+      nl = s[i] == '\n';
+  if((f->flags & S_UNBUF) || nl)
+    flush(f);
+  return nmemb;
+}
+
+int
+fputc(int c, FILE *f)
+{
+  char ch = c;
+
+  return fwrite(&ch, 1, 1, f) == 1 ? (uchar)c : EOF;
+}
+
+// Refill f's buffer. A program about to wait for input should
+// have shown its prompt, so line-buffered output goes first.
+static int
+fill(FILE *f)
+{
+  if(stdout->flags & S_LINE)
+    fflush(stdout);
+  f->pos = 0;
+  f->n = read(f->fd, f->buf, BUFSIZ);
+  if(f->n <= 0){
+    f->flags |= f->n == 0 ? S_EOF : S_ERR;
+    f->n = 0;
+    return EOF;
+  }
+  return 0;
+}
+
+int
+fread(void *p, int size, int nmemb, FILE *f)
+{
+  char *d = p;
+  int n = size * nmemb, i, m;
+
+  if(!(f->flags & S_READ) || n <= 0)
+    return 0;
+  for(i = 0; i < n; i += m){
+    if(f->pos == f->n){
+      if(n - i >= BUFSIZ){
+        // read big requests straight into place.
+        if((m = read(f->fd, d + i, n - i)) <= 0){
+          f->flags |= m == 0 ? S_EOF : S_ERR;
+          break;
+        }
+        continue;
+      }
+      if(fill(f) < 0)
+        break;
+    }
+    m = n - i < f->n - f->pos ? n - i : f->n - f->pos;
+    memmove(d + i, f->buf + f->pos, m);
+    f->pos += m;
+  }
+  return i / size;
+}
+
+int
+fgetc(FILE *f)
+{
+  uchar c;
+
+  return fread(&c, 1, 1, f) == 1 ? c : EOF;
+}
+
+int
+feof(FILE *f)
+{
+  return (f->flags & S_EOF) != 0;
+}
+
+int
+ferror(FILE *f)
+{
+  return (f->flags & S_ERR) != 0;
+}
+
+// The system calls that end or copy the process image flush
+// buffered output first; usys.S has them as _exit and so on.
+
+int
+exit(int status)
+{
+  fflush(0);
+  _exit(status);
+}
+
+int
+fork(void)
+{
+  fflush(0);
+  return _fork();
+}
+
+int
+exec(char *path, char **argv)
+{
+  fflush(0);
+  return _exec(path, argv);
+}
@@ -2,89 +2,181 @@
 #include "kernel/stat.h"
 #include "user/user.h"
 #include "kernel/param.h"
+#include "kernel/riscv.h"
 
-// Memory allocator by Kernighan and Ritchie,
-// The C programming Language, 2nd ed.  Section 8.7.
+// Memory allocator with segregated size classes.
+// A small request is rounded up to a power-of-two block size
+// (16 to 2048 bytes, header included). Each size class carves
+// its blocks from pages of its own and keeps freed blocks on a
+// list of its own, so small malloc() and free() are O(1).
+// Larger requests get a run of whole pages. Free runs are kept
+// in address order and merged with their neighbours, and a big
+// enough free run at the top of the heap is handed back to the
+// kernel with a negative sbrk().
 
-typedef long Align;
+#define NCLASS   8      // block sizes MINBLOCK << 0 .. NCLASS-1
+#define MINBLOCK 16
+#define LARGE    NCLASS // the class of a page-run block
+#define MINGROW  16     // pages to take from sbrk() at a time
+#define TRIM     64     // free pages at the top worth giving back
+#define MAXPAGES ((1U << 31) / PGSIZE - 2)  // sbrk() takes an int
 
-union header {
-  struct {
-    union header *ptr;
-    uint size;
-  } s;
-  Align x;
+// the start of every block. A free small block keeps its
+// free-list link just after the header.
+typedef struct header {
+  uint class;
+  uint npages;  // LARGE blocks: pages in the run
+} Header;
+
+// a run of free pages.
+struct run {
+  struct run *next;
+  uint npages;
 };
 
-typedef union header Header;
+struct sizeclass {
+  Header *free;      // freed blocks
+  char *next, *end;  // not yet carved part of the newest page
+};
 
-static Header base;
-static Header *freep;
+static struct sizeclass classes[NCLASS];
+static struct run *runs;  // free page runs, in address order
 
-void
-free(void *ap)
+#define FREELINK(h) (*(Header**)((h) + 1))
+
+// Put n pages at p on the run list, merged with any
+// free runs just before and after them.
+static void
+freepages(char *p, uint n)
+{
+  struct run *r, *prev, *q;
+
+  prev = 0;
+  for(q = runs; q && (char*)q < p; q = q->next)
+    prev = q;
+  r = (struct run*)p;
+  r->npages = n;
+  r->next = q;
+  if(q && p + (uint64)n*PGSIZE == (char*)q){
+    r->npages += q->npages;
+    r->next = q->next;
+  }
+  if(prev && (char*)prev + (uint64)prev->npages*PGSIZE == p){
+    prev->npages += r->npages;
+    prev->next = r->next;
+  } else if(prev){
+    prev->next = r;
+  } else {
+    runs = r;
+  }
+}
+
+// Give the last free run back to the kernel if it is
+// large and nothing has been sbrk()ed above it.
+static void
+trim(void)
 {
-  Header *bp, *p;
-
-  bp = (Header*)ap - 1;
-  for(p = freep; !(bp > p && bp < p->s.ptr); p = p->s.ptr)
-    if(p >= p->s.ptr && (bp > p || bp < p->s.ptr))
-      break;
-  if(bp + bp->s.size == p->s.ptr){
-    bp->s.size += p->s.ptr->s.size;
-    bp->s.ptr = p->s.ptr->s.ptr;
-  } else
-    bp->s.ptr = p->s.ptr;
-  if(p + p->s.size == bp){
-    p->s.size += bp->s.size;
-    p->s.ptr = bp->s.ptr;
-  } else
-    p->s.ptr = bp;
-  freep = p;
+  struct run **pp, *r;
+
+  if(runs == 0)
+    return;
+  for(pp = &runs; (*pp)->next; pp = &(*pp)->next)
+    ;
+  r = *pp;
+  if(r->npages >= TRIM && (char*)r + (uint64)r->npages*PGSIZE == sbrk(0) &&
+     sbrk(-(int)(r->npages*PGSIZE)) != (char*)-1)
+    *pp = 0;
 }
 
-static Header*
-morecore(uint nu)
+// Take n pages: from the first free run big enough,
+// else from sbrk(). Returns 0 if out of memory.
+static char*
+getpages(uint n)
 {
+  struct run **pp, *r;
   char *p;
-  Header *hp;
+  uint pad, grow;
+
+  for(pp = &runs; (r = *pp) != 0; pp = &r->next){
+    if(r->npages == n){
+      *pp = r->next;
+      return (char*)r;
+    }
+    if(r->npages > n){
+      r->npages -= n;
+      return (char*)r + (uint64)r->npages*PGSIZE;
+    }
+  }
 
-  if(nu < 4096)
-    nu = 4096;
-  p = sbrk(nu * sizeof(Header));
-  if(p == (char*)-1)
+  if(n > MAXPAGES)
     return 0;
-  hp = (Header*)p;
-  hp->s.size = nu;
-  free((void*)(hp + 1));
-  return freep;
+  p = sbrk(0);
+  pad = PGROUNDUP((uint64)p) - (uint64)p;
+  grow = n < MINGROW ? MINGROW : n;
+  if((p = sbrk(pad + grow*PGSIZE)) == (char*)-1){
+    grow = n;
+    if((p = sbrk(pad + grow*PGSIZE)) == (char*)-1)
+      return 0;
+  }
+  p += pad;
+  if(grow > n)
+    freepages(p + (uint64)n*PGSIZE, grow - n);
+  return p;
+}
+
+void
+free(void *ap)
+{
+  Header *h;
+  struct sizeclass *c;
+
+  if(ap == 0)
+    return;
+  h = (Header*)ap - 1;
+  if(h->class == LARGE){
+    freepages((char*)h, h->npages);
+    trim();
+    return;
+  }
+  c = &classes[h->class];
+  FREELINK(h) = c->free;
+  c->free = h;
 }
 
 void*
 malloc(uint nbytes)
 {
-  Header *p, *prevp;
-  uint nunits;
+  struct sizeclass *c;
+  Header *h;
+  uint64 n;
+  uint i;
+  char *p;
 
-  nunits = (nbytes + sizeof(Header) - 1)/sizeof(Header) + 1;
-  if((prevp = freep) == 0){
-    base.s.ptr = freep = prevp = &base;
-    base.s.size = 0;
+  n = (uint64)nbytes + sizeof(Header);
+  for(i = 0; i < NCLASS && (MINBLOCK << i) < n; i++)
+    ;
+  if(i == LARGE){
+    n = (n + PGSIZE - 1) / PGSIZE;
+    if(n > MAXPAGES || (h = (Header*)getpages(n)) == 0)
+      return 0;
+    h->class = LARGE;
+    h->npages = n;
+    return h + 1;
   }
-  for(p = prevp->s.ptr; ; prevp = p, p = p->s.ptr){
-    if(p->s.size >= nunits){
-      if(p->s.size == nunits)
-        prevp->s.ptr = p->s.ptr;
-      else {
-        p->s.size -= nunits;
-        p += p->s.size;
-        p->s.size = nunits;
-      }
-      freep = prevp;
-      return (void*)(p + 1);
-    }
-    if(p == freep)
-      if((p = morecore(nunits)) == 0)
-        return 0;
+
+  c = &classes[i];
+  if((h = c->free) != 0){
+    c->free = FREELINK(h);
+    return h + 1;
+  }
+  if(c->next == c->end){
+    if((p = getpages(1)) == 0)
+      return 0;
+    c->next = p;
+    c->end = p + PGSIZE;
   }
+  h = (Header*)c->next;
+  c->next += MINBLOCK << i;
+  h->class = i;
+  return h + 1;
 }
@@ -1,5 +1,12 @@
 struct stat;
 struct rtcdate;
+struct aio_ring;
+struct iovec;
+struct pollfd;
+struct epoll_event;
+struct profsample;
+struct ktevent;
+struct sysstat;
 
 // system calls
 int fork(void);
@@ -23,6 +30,32 @@ int getpid(void);
 char* sbrk(int);
 int sleep(int);
 int uptime(void);
+struct aio_ring* aiosetup(void);
+int aioenter(int, int);
+int readv(int, const struct iovec*, int);
+int writev(int, const struct iovec*, int);
+int pread(int, void*, int, int);
+int pwrite(int, const void*, int, int);
+int lseek(int, int, int);
+int splice(int, int, int);
+int fcntl(int, int, int);
+int poll(struct pollfd*, int, int);
+int epoll_create(void);
+int epoll_ctl(int, int, int, struct epoll_event*);
+int epoll_wait(int, struct epoll_event*, int, int);
+int clone(void(*)(void*), void*, void*);
+int join(int, void**);
+int futex_wait(volatile int*, int);
+int futex_wake(volatile int*, int);
+int setpriority(int, int);
+int nanosleep(uint64);
+int prof(int, int, struct profsample*);
+int ktrace(int, int, struct ktevent*);
+int sysstat(int, int, struct sysstat*);
+int dmesg(char*, int);
+int _fork(void);
+int _exit(int) __attribute__((noreturn));
+int _exec(char*, char**);
 
 // ulib.c
 int stat(const char*, struct stat*);
@@ -30,8 +63,6 @@ char* strcpy(char*, const char*);
 void *memmove(void*, const void*, int);
 char* strchr(const char*, char c);
 int strcmp(const char*, const char*);
-void fprintf(int, const char*, ...);
-void printf(const char*, ...);
 char* gets(char*, int max);
 uint strlen(const char*);
 void* memset(void*, int, uint);
@@ -40,3 +71,43 @@ void free(void*);
 int atoi(const char*);
 int memcmp(const void *, const void *, uint);
 void *memcpy(void *, const void *, uint);
+int ugetpid(void);
+int uuptime(void);
+uint64 uptimeus(void);
+int nice(int);
+char* sysname(int);
+typedef struct stream FILE;
+extern FILE *stdin, *stdout, *stderr;
+#define EOF (-1)
+#define BUFSIZ 512
+FILE* fopen(const char*, const char*);
+FILE* fdopen(int, const char*);
+int fclose(FILE*);
+int fflush(FILE*);
+int fread(void*, int, int, FILE*);
+int fwrite(const void*, int, int, FILE*);
+int fgetc(FILE*);
+int fputc(int, FILE*);
+int feof(FILE*);
+int ferror(FILE*);
+
+// printf.c
+void fprintf(FILE*, const char*, ...);
+void printf(const char*, ...);
+
+// thread.c
+struct mutex {
+  volatile int state;  // 0 unlocked, 1 locked, 2 locked with waiters
+};
+struct cond {
+  volatile int seq;    // bumped by every signal
+};
+int thread_create(void(*)(void*), void*);
+int thread_join(int);
+void mutex_init(struct mutex*);
+void mutex_lock(struct mutex*);
+void mutex_unlock(struct mutex*);
+void cond_init(struct cond*);
+void cond_wait(struct cond*, struct mutex*);
+void cond_signal(struct cond*);
+void cond_broadcast(struct cond*);
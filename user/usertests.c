@@ -7,6 +7,13 @@
 #include "kernel/syscall.h"
 #include "kernel/memlayout.h"
 #include "kernel/riscv.h"
+#include "kernel/aio.h"
+#include "kernel/epoll.h"
+#include "kernel/prof.h"
+#include "kernel/ktrace.h"
+#include "kernel/sysstat.h"
+#include "kernel/stats.h"
+#include "kernel/klog.h"
 
 //
 // Tests xv6 system calls.  usertests without arguments runs them all
@@ -1479,6 +1486,1137 @@ bigdir(char *s)
   }
 }
 
+// directory large enough to be converted to an indexed
+// directory, then emptied and removed.
+void
+dirindex(char *s)
+{
+  enum { N = 300 };
+  int i, fd;
+  char name[16];
+
+  if(mkdir("di") != 0){
+    printf("%s: mkdir di failed\n", s);
+    exit(1);
+  }
+  fd = open("di/f", O_CREATE|O_RDWR);
+  if(fd < 0){
+    printf("%s: create di/f failed\n", s);
+    exit(1);
+  }
+  close(fd);
+
+  strcpy(name, "di/x000");
+  for(i = 0; i < N; i++){
+    name[4] = '0' + i / 100;
+    name[5] = '0' + (i / 10) % 10;
+    name[6] = '0' + i % 10;
+    if(link("di/f", name) != 0){
+      printf("%s: link(di/f, %s) failed\n", s, name);
+      exit(1);
+    }
+  }
+  for(i = 0; i < N; i++){
+    name[4] = '0' + i / 100;
+    name[5] = '0' + (i / 10) % 10;
+    name[6] = '0' + i % 10;
+    if((fd = open(name, O_RDONLY)) < 0){
+      printf("%s: open %s failed\n", s, name);
+      exit(1);
+    }
+    close(fd);
+    if(unlink(name) != 0){
+      printf("%s: unlink %s failed\n", s, name);
+      exit(1);
+    }
+    if(open(name, O_RDONLY) >= 0){
+      printf("%s: %s still exists after unlink\n", s, name);
+      exit(1);
+    }
+  }
+  if(unlink("di") == 0){
+    printf("%s: unlink non-empty di succeeded\n", s);
+    exit(1);
+  }
+  if(unlink("di/f") != 0 || unlink("di") != 0){
+    printf("%s: cleanup of di failed\n", s);
+    exit(1);
+  }
+}
+
+// submit one request on the async ring and wait for its result.
+int
+aio1(struct aio_ring *r, int op, int fd, void *addr, int n)
+{
+  struct aio_sqe *e = &r->sq[r->sq_tail % NSQE];
+  int res;
+
+  e->op = op;
+  e->fd = fd;
+  e->addr = (uint64) addr;
+  e->n = n;
+  e->udata = r->sq_tail;
+  r->sq_tail++;
+  if(aioenter(1, 1) != 1 || r->cq_tail == r->cq_head)
+    return -2;
+  if(r->cq[r->cq_head % NCQE].udata != e->udata)
+    return -3;
+  res = r->cq[r->cq_head % NCQE].res;
+  r->cq_head++;
+  return res;
+}
+
+// open, write, fsync, read and close through the async rings.
+void
+aiorings(char *s)
+{
+  struct aio_ring *r;
+  int fd, i, pid, xstatus;
+
+  if((r = aiosetup()) == (struct aio_ring *)-1){
+    printf("%s: aiosetup failed\n", s);
+    exit(1);
+  }
+  if(aiosetup() != r){
+    printf("%s: second aiosetup moved the ring\n", s);
+    exit(1);
+  }
+  if(clone((void(*)(void*))0, 0, buf + sizeof(buf)) != -1){
+    printf("%s: clone with a ring succeeded\n", s);
+    exit(1);
+  }
+
+  if((fd = aio1(r, AIO_OPEN, 0, "aiof", O_CREATE|O_RDWR)) < 0){
+    printf("%s: async open failed %d\n", s, fd);
+    exit(1);
+  }
+  for(i = 0; i < 3*BSIZE; i++)
+    buf[i] = i % 251;
+  if(aio1(r, AIO_WRITE, fd, buf, 3*BSIZE) != 3*BSIZE){
+    printf("%s: async write failed\n", s);
+    exit(1);
+  }
+  if(aio1(r, AIO_FSYNC, fd, 0, 0) != 0){
+    printf("%s: async fsync failed\n", s);
+    exit(1);
+  }
+  if(aio1(r, AIO_CLOSE, fd, 0, 0) != 0){
+    printf("%s: async close failed\n", s);
+    exit(1);
+  }
+  if(aio1(r, AIO_READ, fd, buf, 1) != -1){
+    printf("%s: async read of closed fd succeeded\n", s);
+    exit(1);
+  }
+
+  if((fd = open("aiof", O_RDONLY)) < 0){
+    printf("%s: open aiof failed\n", s);
+    exit(1);
+  }
+  memset(buf, 0, 3*BSIZE);
+  if(aio1(r, AIO_READ, fd, buf, 3*BSIZE) != 3*BSIZE){
+    printf("%s: async read failed\n", s);
+    exit(1);
+  }
+  for(i = 0; i < 3*BSIZE; i++){
+    if(buf[i] != (char)(i % 251)){
+      printf("%s: wrong data at %d\n", s, i);
+      exit(1);
+    }
+  }
+  close(fd);
+  unlink("aiof");
+
+  // a process can exit with a read pending on a pipe
+  // whose only writer is itself, but can't shrink its
+  // memory while the read may still write to it.
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    int fds[2];
+    struct aio_ring *cr;
+    struct aio_sqe *e;
+
+    if((cr = aiosetup()) == (struct aio_ring *)-1 || pipe(fds) < 0)
+      exit(1);
+    e = &cr->sq[cr->sq_tail % NSQE];
+    e->op = AIO_READ;
+    e->fd = fds[0];
+    e->addr = (uint64) buf;
+    e->n = 1;
+    e->udata = 0;
+    cr->sq_tail++;
+    if(aioenter(1, 0) != 1)
+      exit(1);
+    if(sbrk(-PGSIZE) != (char*)-1)
+      exit(1);
+    exit(0);
+  }
+  wait(&xstatus);
+  if(xstatus != 0){
+    printf("%s: pending pipe read child failed\n", s);
+    exit(1);
+  }
+
+  // the ring is not inherited.
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    if(aioenter(0, 0) != -1){
+      printf("%s: child has a ring\n", s);
+      exit(1);
+    }
+    exit(0);
+  }
+  wait(&xstatus);
+  exit(xstatus);
+}
+
+// the USYSCALL page matches the system calls and can't be written.
+void
+usyscallpage(char *s)
+{
+  int pid, xstatus;
+  uint64 t0, t1;
+
+  if(ugetpid() != getpid()){
+    printf("%s: ugetpid %d, getpid %d\n", s, ugetpid(), getpid());
+    exit(1);
+  }
+  if(uptime() - uuptime() > 1){
+    printf("%s: uuptime %d, uptime %d\n", s, uuptime(), uptime());
+    exit(1);
+  }
+  t0 = uptimeus();
+  sleep(2);
+  t1 = uptimeus();
+  if(t1 <= t0){
+    printf("%s: uptimeus went from %d to %d\n", s, (int)t0, (int)t1);
+    exit(1);
+  }
+
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    if(ugetpid() != getpid()){
+      printf("%s: child ugetpid %d, getpid %d\n", s, ugetpid(), getpid());
+      exit(1);
+    }
+    *(int *)USYSCALL = 0;
+    printf("%s: wrote to USYSCALL\n", s);
+    exit(1);
+  }
+  wait(&xstatus);
+  if(xstatus != -1)  // did kernel kill child?
+    exit(1);
+}
+
+// readv, writev, pread, pwrite and lseek.
+void
+vectorio(char *s)
+{
+  enum { HDR = 5, BODY = 4000, TOT = HDR + BODY + 3 };
+  struct iovec iov[3];
+  char hdr[HDR], tail[3];
+  int fd, i, fds[2];
+
+  fd = open("vio", O_CREATE|O_RDWR);
+  if(fd < 0){
+    printf("%s: create vio failed\n", s);
+    exit(1);
+  }
+  for(i = 0; i < BODY; i++)
+    buf[i] = 'a' + i % 26;
+  iov[0].iov_base = "head:";
+  iov[0].iov_len = HDR;
+  iov[1].iov_base = buf;
+  iov[1].iov_len = BODY;
+  iov[2].iov_base = "end";
+  iov[2].iov_len = 3;
+  if(writev(fd, iov, 3) != TOT){
+    printf("%s: writev failed\n", s);
+    exit(1);
+  }
+  if(lseek(fd, 0, SEEK_CUR) != TOT || lseek(fd, 0, SEEK_END) != TOT){
+    printf("%s: offset not at end after writev\n", s);
+    exit(1);
+  }
+  if(lseek(fd, 1, SEEK_END) != -1 || lseek(fd, -1, SEEK_SET) != -1){
+    printf("%s: lseek outside the file succeeded\n", s);
+    exit(1);
+  }
+
+  // pwrite and pread leave the offset alone.
+  if(pwrite(fd, "H", 1, 0) != 1 || pread(fd, hdr, 2, HDR + 26) != 2 ||
+     hdr[0] != 'a' || hdr[1] != 'b' || lseek(fd, 0, SEEK_CUR) != TOT){
+    printf("%s: pwrite/pread failed\n", s);
+    exit(1);
+  }
+
+  if(lseek(fd, 0, SEEK_SET) != 0){
+    printf("%s: lseek to start failed\n", s);
+    exit(1);
+  }
+  memset(buf, 0, BODY);
+  iov[0].iov_base = hdr;
+  iov[1].iov_base = buf;
+  iov[2].iov_base = tail;
+  if(readv(fd, iov, 3) != TOT){
+    printf("%s: readv failed\n", s);
+    exit(1);
+  }
+  if(memcmp(hdr, "Head:", HDR) != 0 || memcmp(tail, "end", 3) != 0){
+    printf("%s: readv returned wrong header or trailer\n", s);
+    exit(1);
+  }
+  for(i = 0; i < BODY; i++){
+    if(buf[i] != 'a' + i % 26){
+      printf("%s: readv returned wrong data at %d\n", s, i);
+      exit(1);
+    }
+  }
+  if(readv(fd, iov, 3) != 0){
+    printf("%s: readv past end returned data\n", s);
+    exit(1);
+  }
+  if(readv(fd, iov, IOV_MAX+1) != -1){
+    printf("%s: readv with too many buffers succeeded\n", s);
+    exit(1);
+  }
+  close(fd);
+  unlink("vio");
+
+  if(pipe(fds) != 0){
+    printf("%s: pipe failed\n", s);
+    exit(1);
+  }
+  if(pwrite(fds[1], "x", 1, 0) != -1 || lseek(fds[0], 0, SEEK_SET) != -1){
+    printf("%s: positional I/O on a pipe succeeded\n", s);
+    exit(1);
+  }
+  iov[0].iov_base = "ab";
+  iov[0].iov_len = 2;
+  iov[1].iov_base = "cd";
+  iov[1].iov_len = 2;
+  if(writev(fds[1], iov, 2) != 4 || read(fds[0], hdr, 4) != 4 ||
+     memcmp(hdr, "abcd", 4) != 0){
+    printf("%s: writev to a pipe failed\n", s);
+    exit(1);
+  }
+  close(fds[0]);
+  close(fds[1]);
+}
+
+// splice from a file to a pipe and from a pipe to a file.
+void
+splicetest(char *s)
+{
+  enum { N = 3000 };
+  int fd, fd2, fds[2], i, n, tot, pid, xstatus;
+
+  fd = open("sp1", O_CREATE|O_RDWR);
+  if(fd < 0){
+    printf("%s: create sp1 failed\n", s);
+    exit(1);
+  }
+  for(i = 0; i < N; i++)
+    buf[i] = 'a' + i % 23;
+  if(write(fd, buf, N) != N){
+    printf("%s: write sp1 failed\n", s);
+    exit(1);
+  }
+  close(fd);
+
+  if(pipe(fds) != 0){
+    printf("%s: pipe failed\n", s);
+    exit(1);
+  }
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    // file -> pipe
+    close(fds[0]);
+    fd = open("sp1", O_RDONLY);
+    for(tot = 0; (n = splice(fd, fds[1], N)) > 0; tot += n)
+      ;
+    exit(n == 0 && tot == N ? 0 : 1);
+  }
+  // pipe -> file
+  close(fds[1]);
+  fd2 = open("sp2", O_CREATE|O_RDWR);
+  if(fd2 < 0){
+    printf("%s: create sp2 failed\n", s);
+    exit(1);
+  }
+  for(tot = 0; (n = splice(fds[0], fd2, N)) > 0; tot += n)
+    ;
+  close(fds[0]);
+  wait(&xstatus);
+  if(xstatus != 0 || n != 0 || tot != N){
+    printf("%s: splice moved %d bytes, child status %d\n", s, tot, xstatus);
+    exit(1);
+  }
+
+  memset(buf, 0, N);
+  if(pread(fd2, buf, N+1, 0) != N){
+    printf("%s: sp2 has the wrong size\n", s);
+    exit(1);
+  }
+  for(i = 0; i < N; i++){
+    if(buf[i] != 'a' + i % 23){
+      printf("%s: sp2 has wrong data at %d\n", s, i);
+      exit(1);
+    }
+  }
+  fd = open("sp1", O_RDONLY);
+  if(splice(fd, fd2, 1) != -1){
+    printf("%s: splice between two files succeeded\n", s);
+    exit(1);
+  }
+  close(fd);
+  close(fd2);
+  unlink("sp1");
+  unlink("sp2");
+}
+
+// resize a pipe's buffer with fcntl.
+void
+pipesize(char *s)
+{
+  enum { SZ = 2*4096 };
+  int fds[2], fd, i;
+
+  if(pipe(fds) != 0){
+    printf("%s: pipe failed\n", s);
+    exit(1);
+  }
+  if(fcntl(fds[0], F_GETPIPE_SZ, 0) != 4096){
+    printf("%s: default pipe size is not a page\n", s);
+    exit(1);
+  }
+  if(fcntl(fds[1], F_SETPIPE_SZ, SZ - 4095) != SZ){
+    printf("%s: F_SETPIPE_SZ did not round up to pages\n", s);
+    exit(1);
+  }
+  // a full buffer's worth goes in without a reader.
+  for(i = 0; i < SZ; i++)
+    buf[i] = i % 199;
+  if(write(fds[1], buf, SZ) != SZ){
+    printf("%s: write of %d bytes failed\n", s, SZ);
+    exit(1);
+  }
+  if(fcntl(fds[1], F_SETPIPE_SZ, 4096) != -1){
+    printf("%s: shrink below buffered data succeeded\n", s);
+    exit(1);
+  }
+  if(read(fds[0], buf, 100) != 100 ||
+     fcntl(fds[1], F_SETPIPE_SZ, 3*4096) != 3*4096){
+    printf("%s: grow with data buffered failed\n", s);
+    exit(1);
+  }
+  memset(buf, 0, SZ);
+  if(read(fds[0], buf + 100, SZ) != SZ - 100){
+    printf("%s: read after resize failed\n", s);
+    exit(1);
+  }
+  for(i = 100; i < SZ; i++){
+    if(buf[i] != (char)(i % 199)){
+      printf("%s: wrong data at %d after resize\n", s, i);
+      exit(1);
+    }
+  }
+  close(fds[0]);
+  close(fds[1]);
+
+  fd = open("README", O_RDONLY);
+  if(fd >= 0 && fcntl(fd, F_GETPIPE_SZ, 0) != -1){
+    printf("%s: F_GETPIPE_SZ on a file succeeded\n", s);
+    exit(1);
+  }
+  close(fd);
+}
+
+// poll() on pipes, and non-blocking pipe reads.
+void
+polltest(char *s)
+{
+  struct pollfd pfd[3];
+  int fds[2], pid, t0;
+  char c;
+
+  if(pipe(fds) != 0){
+    printf("%s: pipe failed\n", s);
+    exit(1);
+  }
+  pfd[0].fd = fds[0];
+  pfd[0].events = POLLIN;
+  pfd[1].fd = fds[1];
+  pfd[1].events = POLLOUT;
+  pfd[2].fd = NOFILE - 1;
+  pfd[2].events = POLLIN;
+  if(poll(pfd, 3, 0) != 2 || pfd[0].revents != 0 ||
+     pfd[1].revents != POLLOUT || pfd[2].revents != POLLNVAL){
+    printf("%s: poll of an empty pipe is wrong\n", s);
+    exit(1);
+  }
+
+  // non-blocking read of an empty pipe fails at once.
+  if(fcntl(fds[0], F_SETFL, O_NONBLOCK) != 0 ||
+     (fcntl(fds[0], F_GETFL, 0) & O_NONBLOCK) == 0 ||
+     read(fds[0], &c, 1) != -1){
+    printf("%s: non-blocking read did not fail\n", s);
+    exit(1);
+  }
+
+  t0 = uptime();
+  if(poll(pfd, 1, 3) != 0 || uptime() - t0 < 3){
+    printf("%s: poll timeout returned early\n", s);
+    exit(1);
+  }
+
+  // a write by another process wakes a blocked poll.
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    sleep(2);
+    write(fds[1], "x", 1);
+    exit(0);
+  }
+  if(poll(pfd, 1, -1) != 1 || pfd[0].revents != POLLIN ||
+     read(fds[0], &c, 1) != 1 || c != 'x'){
+    printf("%s: poll did not see the write\n", s);
+    exit(1);
+  }
+  wait(0);
+
+  close(fds[1]);
+  if(poll(pfd, 1, -1) != 1 || (pfd[0].revents & POLLHUP) == 0 ||
+     read(fds[0], &c, 1) != 0){
+    printf("%s: poll did not see the writer close\n", s);
+    exit(1);
+  }
+  close(fds[0]);
+}
+
+// edge-triggered events from several pipes through one epoll.
+void
+epolltest(char *s)
+{
+  enum { N = 3 };
+  struct epoll_event ev[N+1];
+  int ep, fds[N][2], i;
+  char c;
+
+  if((ep = epoll_create()) < 0){
+    printf("%s: epoll_create failed\n", s);
+    exit(1);
+  }
+  for(i = 0; i < N; i++){
+    if(pipe(fds[i]) != 0){
+      printf("%s: pipe failed\n", s);
+      exit(1);
+    }
+    ev[0].events = POLLIN;
+    ev[0].data = 100 + i;
+    if(epoll_ctl(ep, EPOLL_CTL_ADD, fds[i][0], &ev[0]) != 0){
+      printf("%s: EPOLL_CTL_ADD failed\n", s);
+      exit(1);
+    }
+  }
+  if(epoll_ctl(ep, EPOLL_CTL_ADD, fds[0][0], &ev[0]) != -1){
+    printf("%s: second EPOLL_CTL_ADD of one fd succeeded\n", s);
+    exit(1);
+  }
+  if(epoll_wait(ep, ev, N+1, 0) != 0){
+    printf("%s: events from empty pipes\n", s);
+    exit(1);
+  }
+
+  write(fds[1][1], "ab", 2);
+  if(epoll_wait(ep, ev, N+1, -1) != 1 || ev[0].data != 101 || ev[0].events != POLLIN){
+    printf("%s: wrong event for a write\n", s);
+    exit(1);
+  }
+  // edge-triggered: the unread byte doesn't report again...
+  read(fds[1][0], &c, 1);
+  if(epoll_wait(ep, ev, N+1, 2) != 0){
+    printf("%s: event without a change\n", s);
+    exit(1);
+  }
+  // ...until the pipe goes empty and fills again.
+  read(fds[1][0], &c, 1);
+  write(fds[1][1], "c", 1);
+  write(fds[2][1], "d", 1);
+  if(epoll_wait(ep, ev, N+1, -1) != 2 || ev[0].data + ev[1].data != 101 + 102){
+    printf("%s: wrong events for two writes\n", s);
+    exit(1);
+  }
+
+  close(fds[0][1]);
+  if(epoll_wait(ep, ev, N+1, -1) != 1 || ev[0].data != 100 ||
+     ev[0].events != (POLLIN|POLLHUP)){
+    printf("%s: wrong event for a close\n", s);
+    exit(1);
+  }
+
+  // closing or deleting a watched fd stops its events.
+  if(epoll_ctl(ep, EPOLL_CTL_DEL, fds[1][0], 0) != 0 ||
+     epoll_ctl(ep, EPOLL_CTL_DEL, fds[1][0], 0) != -1){
+    printf("%s: EPOLL_CTL_DEL failed\n", s);
+    exit(1);
+  }
+  close(fds[2][0]);
+  read(fds[1][0], &c, 1);
+  write(fds[1][1], "e", 1);
+  if(epoll_wait(ep, ev, N+1, 2) != 0){
+    printf("%s: event from a removed fd\n", s);
+    exit(1);
+  }
+  if(read(ep, &c, 1) != -1){
+    printf("%s: read of an epoll fd succeeded\n", s);
+    exit(1);
+  }
+  close(ep);
+  close(fds[0][0]);
+  close(fds[1][0]);
+  close(fds[1][1]);
+  close(fds[2][1]);
+}
+
+// state shared by threadtest's threads.
+struct tharg {
+  int id;
+  int fd;
+  char *mem;
+} tharg[4];
+volatile int thcount[4];
+volatile int thspin;
+
+void
+thworker(void *a)
+{
+  struct tharg *t = a;
+
+  for(int i = 0; i < 1000; i++)
+    thcount[t->id]++;
+  // memory and descriptors are shared with the main thread.
+  if(t->id == 0){
+    if((t->mem = sbrk(4096)) != (char*)-1)
+      t->mem[0] = 'x';
+    t->fd = open("thfile", O_CREATE|O_RDWR);
+  }
+}
+
+void
+thspinner(void *a)
+{
+  while(thspin)
+    ;
+}
+
+// threads made by clone() share memory and descriptors,
+// are joined by the main thread, and die with it.
+void
+threadtest(char *s)
+{
+  int tid[4], i, pid, xstatus;
+
+  for(i = 0; i < 4; i++){
+    tharg[i].id = i;
+    tharg[i].fd = -1;
+    if((tid[i] = thread_create(thworker, &tharg[i])) < 0){
+      printf("%s: thread_create failed\n", s);
+      exit(1);
+    }
+  }
+  if(wait(0) != -1){
+    printf("%s: wait returned a thread\n", s);
+    exit(1);
+  }
+  for(i = 3; i >= 0; i--){
+    if(thread_join(tid[i]) != tid[i]){
+      printf("%s: thread_join failed\n", s);
+      exit(1);
+    }
+  }
+  if(join(0, 0) != -1){
+    printf("%s: join with no threads succeeded\n", s);
+    exit(1);
+  }
+  for(i = 0; i < 4; i++){
+    if(thcount[i] != 1000){
+      printf("%s: thread %d counted %d\n", s, i, thcount[i]);
+      exit(1);
+    }
+  }
+  if(tharg[0].mem == (char*)-1 || tharg[0].mem[0] != 'x'){
+    printf("%s: memory from a thread's sbrk not shared\n", s);
+    exit(1);
+  }
+  if(tharg[0].fd < 0 || write(tharg[0].fd, "y", 1) != 1){
+    printf("%s: descriptor from a thread not shared\n", s);
+    exit(1);
+  }
+  close(tharg[0].fd);
+  unlink("thfile");
+
+  // exiting with threads still running kills them.
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    thspin = 1;
+    for(i = 0; i < 2; i++){
+      if(thread_create(thspinner, 0) < 0){
+        printf("%s: thread_create failed\n", s);
+        exit(1);
+      }
+    }
+    sleep(1);
+    exit(0);
+  }
+  wait(&xstatus);
+  if(xstatus != 0)
+    exit(xstatus);
+}
+
+// shared by futextest's threads.
+struct mutex ftmu;
+struct cond ftcond;
+int ftgo, ftcount, ftdone;
+
+void
+ftworker(void *a)
+{
+  mutex_lock(&ftmu);
+  while(!ftgo)
+    cond_wait(&ftcond, &ftmu);
+  mutex_unlock(&ftmu);
+
+  for(int i = 0; i < 2000; i++){
+    mutex_lock(&ftmu);
+    ftcount++;  // not atomic: only the mutex makes this safe
+    mutex_unlock(&ftmu);
+  }
+
+  mutex_lock(&ftmu);
+  ftdone++;
+  cond_signal(&ftcond);
+  mutex_unlock(&ftmu);
+}
+
+// futex_wait()/futex_wake(), and the mutexes and condition
+// variables built on them.
+void
+futextest(char *s)
+{
+  enum { N = 4 };
+  volatile int word = 1;
+  int tid[N], i;
+
+  if(futex_wait(&word, 0) != -1){
+    printf("%s: futex_wait on a changed word slept\n", s);
+    exit(1);
+  }
+  if(futex_wake(&word, 1) != 0){
+    printf("%s: futex_wake woke a waiter that doesn't exist\n", s);
+    exit(1);
+  }
+
+  mutex_init(&ftmu);
+  cond_init(&ftcond);
+  for(i = 0; i < N; i++){
+    if((tid[i] = thread_create(ftworker, 0)) < 0){
+      printf("%s: thread_create failed\n", s);
+      exit(1);
+    }
+  }
+  sleep(1);
+  mutex_lock(&ftmu);
+  ftgo = 1;
+  cond_broadcast(&ftcond);
+  while(ftdone < N)
+    cond_wait(&ftcond, &ftmu);
+  mutex_unlock(&ftmu);
+  for(i = 0; i < N; i++){
+    if(thread_join(tid[i]) != tid[i]){
+      printf("%s: thread_join failed\n", s);
+      exit(1);
+    }
+  }
+  if(ftcount != N*2000){
+    printf("%s: count %d, not %d\n", s, ftcount, N*2000);
+    exit(1);
+  }
+}
+
+// setpriority() and nice(): ranges, and inheritance by fork().
+void
+nicetest(char *s)
+{
+  int pid, xstatus;
+
+  if(setpriority(0, -1) != 0){
+    printf("%s: nice value doesn't start at 0\n", s);
+    exit(1);
+  }
+  if(setpriority(0, 2) != 0 || setpriority(0, -1) != 2){
+    printf("%s: setpriority didn't set\n", s);
+    exit(1);
+  }
+  if(setpriority(0, 99) != -1 || setpriority(0, -2) != -1){
+    printf("%s: setpriority took a bad value\n", s);
+    exit(1);
+  }
+  if(setpriority(NPROC*1000, 0) != -1){
+    printf("%s: setpriority of a missing pid succeeded\n", s);
+    exit(1);
+  }
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0)
+    exit(setpriority(0, -1) == 2 ? 0 : 1);
+  wait(&xstatus);
+  if(xstatus != 0){
+    printf("%s: child didn't inherit its nice value\n", s);
+    exit(1);
+  }
+  if(nice(100) != NMLFQ-1 || nice(-100) != 0){
+    printf("%s: nice didn't clamp\n", s);
+    exit(1);
+  }
+}
+
+// buffered streams: output reaches the file exactly once,
+// across fork(), and reads back byte-wise and in bulk.
+void
+stdiotest(char *s)
+{
+  FILE *f;
+  int i, n, pid, xstatus;
+
+  unlink("stdio");
+  if((f = fopen("stdio", "w")) == 0){
+    printf("%s: fopen w failed\n", s);
+    exit(1);
+  }
+  fprintf(f, "a%d", 12);
+  pid = fork();  // must not copy "a12" into the child's buffer
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    fputc('b', f);
+    exit(0);  // flushes "b"
+  }
+  wait(&xstatus);
+  for(i = 0; i < 3*BUFSIZ; i++)
+    fputc('0' + i % 10, f);
+  if(fclose(f) != 0 || xstatus != 0){
+    printf("%s: fclose failed\n", s);
+    exit(1);
+  }
+
+  if((f = fopen("stdio", "a")) == 0 || fwrite("end", 1, 3, f) != 3 || fclose(f) != 0){
+    printf("%s: append failed\n", s);
+    exit(1);
+  }
+
+  if((f = fopen("stdio", "r")) == 0){
+    printf("%s: fopen r failed\n", s);
+    exit(1);
+  }
+  if(fgetc(f) != 'a' || fgetc(f) != '1' || fgetc(f) != '2' || fgetc(f) != 'b'){
+    printf("%s: wrong start\n", s);
+    exit(1);
+  }
+  n = fread(buf, 1, sizeof(buf), f);
+  if(n != 3*BUFSIZ + 3 || !feof(f) || fgetc(f) != EOF){
+    printf("%s: read %d bytes\n", s, n);
+    exit(1);
+  }
+  for(i = 0; i < 3*BUFSIZ; i++){
+    if(buf[i] != '0' + i % 10){
+      printf("%s: wrong byte at %d\n", s, i);
+      exit(1);
+    }
+  }
+  if(memcmp(buf + 3*BUFSIZ, "end", 3) != 0){
+    printf("%s: wrong end\n", s);
+    exit(1);
+  }
+  fclose(f);
+  unlink("stdio");
+}
+
+// malloc() size classes and large blocks keep their contents
+// apart, and freeing a big block shrinks the heap again.
+void
+malloctest(char *s)
+{
+  char *p[64], *top;
+  int i, j, n;
+
+  for(i = 0; i < 64; i++){
+    n = (i * 37) % 3000 + 1;
+    if((p[i] = malloc(n)) == 0){
+      printf("%s: malloc(%d) failed\n", s, n);
+      exit(1);
+    }
+    memset(p[i], i, n);
+  }
+  for(i = 0; i < 64; i++){
+    n = (i * 37) % 3000 + 1;
+    for(j = 0; j < n; j++){
+      if(p[i][j] != i){
+        printf("%s: block %d overwritten\n", s, i);
+        exit(1);
+      }
+    }
+    free(p[i]);
+  }
+  p[0] = malloc(100);
+  free(p[0]);
+  if(malloc(100) != p[0]){
+    printf("%s: freed block not reused\n", s);
+    exit(1);
+  }
+
+  top = sbrk(0);
+  if((p[0] = malloc(1024*1024)) == 0){
+    printf("%s: malloc of 1 MB failed\n", s);
+    exit(1);
+  }
+  p[0][1024*1024-1] = 1;
+  free(p[0]);
+  if(sbrk(0) > top){
+    printf("%s: heap didn't shrink\n", s);
+    exit(1);
+  }
+}
+
+// nanosleep() sleeps at least as long as asked, and wakes well
+// inside a clock tick rather than at the next one.
+void
+nanosleeptest(char *s)
+{
+  uint64 t0, dt;
+
+  if(nanosleep(0) != 0){
+    printf("%s: nanosleep(0) failed\n", s);
+    exit(1);
+  }
+  for(int i = 0; i < 5; i++){
+    t0 = uptimeus();
+    if(nanosleep(20*1000*1000) != 0){
+      printf("%s: nanosleep failed\n", s);
+      exit(1);
+    }
+    dt = uptimeus() - t0;
+    if(dt < 20000 || dt >= 100000){
+      printf("%s: 20 ms nanosleep took %d us\n", s, (int)dt);
+      exit(1);
+    }
+  }
+}
+
+// the profiler samples a busy loop in user space.
+void
+proftest(char *s)
+{
+  struct profsample *ps = (struct profsample*)buf;
+  int n, i, mine;
+  uint64 t0;
+  volatile int x = 0;
+
+  if(prof(PROF_START, 0, 0) != -1 || prof(PROF_START, PROF_MININTERVAL - 1, 0) != -1){
+    printf("%s: started with too short an interval\n", s);
+    exit(1);
+  }
+  if(prof(PROF_START, 1000, 0) < 0){
+    printf("%s: PROF_START failed\n", s);
+    exit(1);
+  }
+  t0 = uptimeus();
+  while(uptimeus() - t0 < 100000)
+    x++;
+  prof(PROF_STOP, 0, 0);
+
+  mine = 0;
+  while((n = prof(PROF_READ, sizeof(buf) / sizeof(*ps), ps)) > 0)
+    for(i = 0; i < n; i++)
+      if(ps[i].pid == getpid() && ps[i].user)
+        mine++;
+  if(n < 0 || mine < 10){
+    printf("%s: only %d samples of the busy loop\n", s, mine);
+    exit(1);
+  }
+}
+
+// tracepoints record a system call's entry and exit, in order.
+void
+ktracetest(char *s)
+{
+  struct ktevent *e = (struct ktevent*)buf;
+  int n, i, entered, returned;
+  uint64 last;
+
+  if(ktrace(KT_START, (1 << KT_SYSCALL) | (1 << KT_SYSRET), 0) < 0){
+    printf("%s: KT_START failed\n", s);
+    exit(1);
+  }
+  uptime();
+  ktrace(KT_STOP, 0, 0);
+
+  entered = returned = 0;
+  last = 0;
+  while((n = ktrace(KT_READ, sizeof(buf) / sizeof(*e), e)) > 0){
+    for(i = 0; i < n; i++){
+      if(e[i].time < last){
+        printf("%s: events out of order\n", s);
+        exit(1);
+      }
+      last = e[i].time;
+      if(e[i].pid != getpid() || e[i].a != SYS_uptime)
+        continue;
+      if(e[i].type == KT_SYSCALL)
+        entered = 1;
+      else if(e[i].type == KT_SYSRET && entered)
+        returned = 1;
+    }
+  }
+  if(!returned){
+    printf("%s: uptime() not traced\n", s);
+    exit(1);
+  }
+}
+
+// sysstat() counts each call, system-wide and per process.
+void
+sysstattest(char *s)
+{
+  struct sysstat before, after, all;
+  int pid, i;
+
+  pid = getpid();
+  if(sysstat(pid, SYS_getpid, &before) < 0){
+    printf("%s: sysstat failed\n", s);
+    exit(1);
+  }
+  for(i = 0; i < 10; i++)
+    getpid();
+  sysstat(pid, SYS_getpid, &after);
+  if(after.count != before.count + 10 || after.cycles < before.cycles){
+    printf("%s: %d getpid() calls counted, not 10\n", s, (int)(after.count - before.count));
+    exit(1);
+  }
+
+  if(sysstat(0, SYS_getpid, &all) < 0 || all.count < after.count){
+    printf("%s: system-wide count too low\n", s);
+    exit(1);
+  }
+  if(sysstat(0, NSYSCALL, &all) != -1 || sysstat(0x7fffffff, SYS_getpid, &all) != -1){
+    printf("%s: bad call number or pid accepted\n", s);
+    exit(1);
+  }
+}
+
+// the stats device returns a fresh snapshot on each read.
+void
+statstest(char *s)
+{
+  struct kstats a, b;
+  int fd;
+
+  if((fd = open("/stats", O_RDWR)) < 0){
+    printf("%s: open /stats failed\n", s);
+    exit(1);
+  }
+  if(read(fd, &a, sizeof(a)) != sizeof(a) || read(fd, &b, sizeof(b)) != sizeof(b)){
+    printf("%s: read failed\n", s);
+    exit(1);
+  }
+  if(b.time <= a.time || a.totalpages == 0 || a.freepages > a.totalpages ||
+     a.nproc < 1 || a.nrunnable >= a.nproc){
+    printf("%s: bad snapshot\n", s);
+    exit(1);
+  }
+  if(read(fd, &a, sizeof(a) - 1) != -1 || write(fd, &a, sizeof(a)) != -1){
+    printf("%s: short read or write accepted\n", s);
+    exit(1);
+  }
+  close(fd);
+}
+
+// what the kernel prints shows up in dmesg(), which returns
+// no more than asked for.
+void
+dmesgtest(char *s)
+{
+  char *log, want[16];
+  int pid, n, i, len;
+
+  // the kernel reports the fault of a child that
+  // reads kernel memory.
+  if((pid = fork()) < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    printf("%s: could read %x\n", s, *(volatile char*)KERNBASE);
+    exit(0);
+  }
+  wait(0);
+  strcpy(want, "pid=");
+  len = 4;
+  for(i = 1; pid / i >= 10; i *= 10)
+    ;
+  for(; i > 0; i /= 10)
+    want[len++] = '0' + pid / i % 10;
+  want[len++] = '\n';
+
+  if((log = malloc(KLOGMAX)) == 0){
+    printf("%s: out of memory\n", s);
+    exit(1);
+  }
+  if((n = dmesg(log, KLOGMAX)) <= 0){
+    printf("%s: dmesg failed\n", s);
+    exit(1);
+  }
+  for(i = n - len; i >= 0 && memcmp(log + i, want, len) != 0; i--)
+    ;
+  if(i < 0){
+    printf("%s: fault message not in the log\n", s);
+    exit(1);
+  }
+  if(dmesg(log, 10) != 10 || dmesg(log, 0) != 0){
+    printf("%s: wrong length returned\n", s);
+    exit(1);
+  }
+  free(log);
+}
+
 void
 subdir(char *s)
 {
@@ -2693,6 +3831,25 @@ main(int argc, char *argv[])
     {dirfile, "dirfile"},
     {iref, "iref"},
     {forktest, "forktest"},
+    {dirindex, "dirindex"},
+    {aiorings, "aiorings"},
+    {usyscallpage, "usyscallpage"},
+    {vectorio, "vectorio"},
+    {splicetest, "splicetest"},
+    {pipesize, "pipesize"},
+    {polltest, "polltest"},
+    {epolltest, "epolltest"},
+    {threadtest, "threadtest"},
+    {futextest, "futextest"},
+    {nicetest, "nicetest"},
+    {stdiotest, "stdiotest"},
+    {malloctest, "malloctest"},
+    {nanosleeptest, "nanosleeptest"},
+    {proftest, "proftest"},
+    {ktracetest, "ktracetest"},
+    {sysstattest, "sysstattest"},
+    {statstest, "statstest"},
+    {dmesgtest, "dmesgtest"},
     {bigdir, "bigdir"}, // slow
     { 0, 0},
   };
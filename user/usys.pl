@@ -6,24 +6,27 @@ print "# generated by usys.pl - do not edit\n";
 
 print "#include \"kernel/syscall.h\"\n";
 
+# entry("x") makes x(); entry("x", "_x") makes the raw system
+# call _x(), for a ulib.c wrapper named x() to call.
 sub entry {
     my $name = shift;
-    print ".global $name\n";
-    print "${name}:\n";
+    my $label = shift || $name;
+    print ".global $label\n";
+    print "${label}:\n";
     print " li a7, SYS_${name}\n";
     print " ecall\n";
     print " ret\n";
 }
 	
-entry("fork");
-entry("exit");
+entry("fork", "_fork");
+entry("exit", "_exit");
 entry("wait");
 entry("pipe");
 entry("read");
 entry("write");
 entry("close");
 entry("kill");
-entry("exec");
+entry("exec", "_exec");
 entry("open");
 entry("mknod");
 entry("unlink");
@@ -36,3 +39,26 @@ entry("getpid");
 entry("sbrk");
 entry("sleep");
 entry("uptime");
+entry("aiosetup");
+entry("aioenter");
+entry("readv");
+entry("writev");
+entry("pread");
+entry("pwrite");
+entry("lseek");
+entry("splice");
+entry("fcntl");
+entry("poll");
+entry("epoll_create");
+entry("epoll_ctl");
+entry("epoll_wait");
+entry("clone");
+entry("join");
+entry("futex_wait");
+entry("futex_wake");
+entry("setpriority");
+entry("nanosleep");
+entry("prof");
+entry("ktrace");
+entry("sysstat");
+entry("dmesg");
@@ -0,0 +1,99 @@
+// Report kernel statistics from the stats device: a line of
+// averages since boot, then, given an interval, a line per
+// interval of what happened in it.
+// usage: vmstat [seconds [count]]
+// Columns: processes in use and runnable, free memory in KB,
+// context switches per second, percent of CPU time idle (of the
+// CPUs that have run), buffer cache hit percent, log commits
+// and blocks logged per second, disk requests and blocks per
+// second, open pipes and KB written to pipes per second.
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/param.h"
+#include "kernel/fcntl.h"
+#include "kernel/riscv.h"
+#include "kernel/memlayout.h"
+#include "kernel/stats.h"
+#include "user/user.h"
+
+int fd;
+
+void
+snapshot(struct kstats *ks)
+{
+  if(read(fd, ks, sizeof(*ks)) != sizeof(*ks)){
+    fprintf(stderr, "vmstat: read stats failed\n");
+    exit(1);
+  }
+}
+
+// n events in cycles of time, per second.
+int
+rate(uint64 n, uint64 cycles, uint64 timebase)
+{
+  return cycles ? n * timebase / cycles : 0;
+}
+
+// One line of the changes from a to b.
+void
+report(struct kstats *a, struct kstats *b, uint64 timebase)
+{
+  uint64 t = b->time - a->time, idle = 0, sw = 0, look;
+  int i, ncpu = 0;
+
+  for(i = 0; i < NCPU; i++){
+    sw += b->nswitch[i] - a->nswitch[i];
+    if(b->nswitch[i] || b->idle[i]){
+      ncpu++;
+      idle += b->idle[i] - a->idle[i];
+    }
+  }
+  if(idle > t * ncpu)
+    idle = t * ncpu;
+  look = (b->bhits - a->bhits) + (b->bmisses - a->bmisses);
+  printf("%d %d %d %d %d %d %d %d %d %d %d %d\n",
+         b->nproc, b->nrunnable, b->freepages * (PGSIZE / 1024),
+         rate(sw, t, timebase),
+         ncpu && t ? (int)(idle * 100 / (t * ncpu)) : 0,
+         look ? (int)((b->bhits - a->bhits) * 100 / look) : 0,
+         rate(b->ncommit - a->ncommit, t, timebase),
+         rate(b->nlogged - a->nlogged, t, timebase),
+         rate(b->nreq - a->nreq, t, timebase),
+         rate(b->nblock - a->nblock, t, timebase),
+         b->npipe, rate(b->pipebytes - a->pipebytes, t, timebase) / 1024);
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct kstats boot, prev, cur;
+  uint64 timebase;
+  int interval = 0, count = -1;
+
+  if(argc > 1 && (interval = atoi(argv[1])) <= 0){
+    fprintf(stderr, "usage: vmstat [seconds [count]]\n");
+    exit(1);
+  }
+  if(argc > 2)
+    count = atoi(argv[2]);
+  if((fd = open("/stats", O_RDONLY)) < 0){
+    fprintf(stderr, "vmstat: cannot open /stats\n");
+    exit(1);
+  }
+  timebase = ((struct usyscall*)USYSCALL)->timebase;
+
+  printf("proc run freekb cs/s idle%% hit%% commit/s logged/s req/s blk/s pipes pipekb/s\n");
+  memset(&boot, 0, sizeof(boot));
+  snapshot(&cur);
+  report(&boot, &cur, timebase);
+  while(interval && count != 1){
+    prev = cur;
+    sleep(interval * 10);
+    snapshot(&cur);
+    report(&prev, &cur, timebase);
+    if(count > 0)
+      count--;
+  }
+  exit(0);
+}